@@ -20,6 +20,63 @@ uint64_t timer_overhead_ns(void);
 // 简单打乱/预热，减少冷启动影响
 void warmup_busy_loop(size_t iters);
 
+// 对数分桶延迟直方图（HDR 风格）：每个 2 的幂区间再线性细分 HIST_SUB_BUCKETS 份，
+// 小于 HIST_SUB_BUCKETS 的值精确记录，其余相对误差 < 1/HIST_SUB_BUCKETS；记录为 O(1)，不保存样本
+#define HIST_SUB_BITS    5
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS     (64 * HIST_SUB_BUCKETS)
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total, sum, min, max;
+} latency_hist;
+
+void     hist_reset(latency_hist *h);
+void     hist_record(latency_hist *h, uint64_t v);
+void     hist_merge(latency_hist *dst, const latency_hist *src);       // 把 src 累加进 dst（多线程各记各的，最后合并）
+uint64_t hist_percentile(const latency_hist *h, double pct);   // pct 取 0..100，返回所在桶的上界
+void     hist_print_header(void);                              // count / mean / p50 / p90 / p99 / p99.9 / max 表头
+void     hist_print_row(const char *label, const latency_hist *h);
+
+// 硬件性能计数器（仅 Linux perf_event；不可用时 open 返回 -1，调用方需自行降级）
+enum { HW_CYCLES, HW_INSTRUCTIONS, HW_BRANCHES, HW_BRANCH_MISSES };
+int      hw_counter_open(int event);
+uint64_t hw_counter_read(int fd);     // 读取当前累计值，差分即为区间计数
+void     hw_counter_close(int fd);
+
+// 线程绑核与 SMT 拓扑（Linux；其他平台 pin 返回 -1，siblings 只返回自身）
+int num_online_cpus(void);
+int pin_thread_to_cpu(int cpu);                        // 绑定调用线程，成功返回 0
+int cpu_smt_siblings(int cpu, int *out, int max);      // 同一物理核上的逻辑 CPU（含自身）
+int cpu_llc_siblings(int cpu, int *out, int max);      // 共享最后一级 cache 的逻辑 CPU（含自身）
+int cpu_package_id(int cpu);                           // 所在 socket 编号，未知返回 -1
+
+// CPU / cache 拓扑：cache 参数按来源分别读取（sysfs → cpuid → macOS sysctl），topology_detect 取第一个可用的来源，
+// 并统计 core / SMT / socket 数；都不可用时退回 32K / 256K / 4M 的默认值（source = "default"）
+enum { CACHE_DATA, CACHE_INST, CACHE_UNIFIED };
+enum { CACHE_SRC_SYSFS, CACHE_SRC_CPUID, CACHE_SRC_SYSCTL };
+#define TOPO_MAX_CACHES 8
+typedef struct {
+    int    level;              // 1 = L1 ...
+    int    type;               // CACHE_DATA / CACHE_INST / CACHE_UNIFIED
+    size_t size, line;         // 字节，未知为 0
+    int    ways, sets;         // 未知为 0
+    int    shared_cpus;        // 共享这一级的逻辑 CPU 数（cpuid 给的是上限）
+} cache_info;
+
+typedef struct {
+    int         ncpus, ncores, nsockets;
+    int         smt;                        // 每个物理核的硬件线程数
+    int         ncaches;
+    cache_info  caches[TOPO_MAX_CACHES];    // 按 level 升序，同级 data 在 instruction 前
+    const char *source;
+} cpu_topology;
+
+int               cache_info_read(int source, cache_info *out, int max);   // 返回条数，不可用返回 0
+void              topology_detect(cpu_topology *t);
+const cache_info *topology_cache(const cpu_topology *t, int level, int type); // type 为 CACHE_DATA 时也匹配 unified
+size_t            topology_per_core(const cpu_topology *t, const cache_info *c); // 平均到每个物理核的容量
+void              topology_print(const cpu_topology *t);
+
 #ifdef __cplusplus
 }
 #endif
@@ -49,4 +49,70 @@ echo "-----------------------------------"
 ./bin/011_smt_sim
 echo "-----------------------------------"
 
+./bin/012_branch_history
+echo "-----------------------------------"
+
+./bin/013_indirect_branch
+echo "-----------------------------------"
+
+./bin/014_call_overhead
+echo "-----------------------------------"
+
+./bin/015_store_forwarding
+echo "-----------------------------------"
+
+./bin/016_ooo_window
+echo "-----------------------------------"
+
+./bin/017_smt_matrix
+echo "-----------------------------------"
+
+./bin/018_false_sharing
+echo "-----------------------------------"
+
+./bin/019_atomics
+echo "-----------------------------------"
+
+./bin/020_locks
+echo "-----------------------------------"
+
+./bin/021_queues
+echo "-----------------------------------"
+
+./bin/022_syscalls
+echo "-----------------------------------"
+
+./bin/023_wakeup
+echo "-----------------------------------"
+
+./bin/024_os_noise
+echo "-----------------------------------"
+
+./bin/025_page_faults
+echo "-----------------------------------"
+
+./bin/026_allocators
+echo "-----------------------------------"
+
+./bin/027_memcpy
+echo "-----------------------------------"
+
+./bin/028_gups
+echo "-----------------------------------"
+
+./bin/029_flops
+echo "-----------------------------------"
+
+./bin/030_denormals
+echo "-----------------------------------"
+
+./bin/031_cache_geometry
+echo "-----------------------------------"
+
+./bin/032_simd_frequency
+echo "-----------------------------------"
+
+./bin/033_ipc
+echo "-----------------------------------"
+
 echo "=== All benchmarks completed successfully ==="
\ No newline at end of file
@@ -0,0 +1,258 @@
+// 012_branch_history.c
+// 实验目的：刻画分支预测器的历史长度与容量
+// 方法：
+//   A) 周期性 taken/not-taken 模式（周期 2..64K），观察误预测率何时开始上升
+//   B) 两个完全相关的分支之间插入 K 个无关分支，观察相关性何时“看不见”（全局历史长度）
+//   C) 同时活跃的静态分支数量 M（宏展开生成），每个分支有各自的短周期模式（预测器容量）
+// 误预测率来自硬件计数器（Linux perf_event），不可用时只输出 cycles/branch
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "harness.h"
+
+#define REPEAT     7
+#define FREQ_GHZ   3.2
+#define BUF_LEN    65536            // 模式缓冲区长度（≥ 最大周期）
+#define TOTAL_BR   (4u << 20)       // 每次测量执行约 4M 个被测分支
+#define SITE_Q     8                // C 部分：每个静态分支的局部模式周期
+
+// K 个填充分支用一个不展开的空循环实现（每次迭代一个回跳分支）
+#if defined(__clang__)
+#define NO_UNROLL _Pragma("clang loop unroll(disable)")
+#else
+#define NO_UNROLL
+#endif
+
+// 两个分支方向各自写不同的 volatile 变量，防止编译器改写成 cmov
+static volatile uint64_t cnt_t, cnt_n;
+static int               fd_miss = -1;
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+typedef struct {
+    const uint8_t *a;       // 第一路条件
+    const uint8_t *b;       // 第二路条件（B 部分中为 a 的拷贝）
+    size_t         len;     // 缓冲区长度
+    size_t         passes;  // 遍历次数
+    int            k;       // B 部分：中间插入的无关分支数
+} kernel_arg;
+
+typedef void (*branch_kernel)(const kernel_arg *);
+
+// 对 kernel 做 REPEAT 次测量，返回每个“单位”（branch 或 iteration）的周期数和误预测数
+static void measure(branch_kernel fn, const kernel_arg *arg, double units,
+                    double *cyc_out, double *miss_out)
+{
+    double cyc[REPEAT], miss[REPEAT];
+    uint64_t t_oh = timer_overhead_ns();
+
+    fn(arg);    // 训练一遍预测器，不计时
+
+    for (int r = 0; r < REPEAT; r++) {
+        warmup_busy_loop(20000);
+
+        uint64_t m0 = hw_counter_read(fd_miss);
+        uint64_t t0 = now_ns();
+        fn(arg);
+        uint64_t t1 = now_ns();
+        uint64_t m1 = hw_counter_read(fd_miss);
+
+        double ns = (double)(int64_t)(t1 - t0 - t_oh);
+        if (ns < 0) ns = 0;
+
+        cyc[r]  = ns * FREQ_GHZ / units;
+        miss[r] = (double)(m1 - m0) / units;
+    }
+    *cyc_out  = median(cyc, REPEAT);
+    *miss_out = median(miss, REPEAT);
+}
+
+static void print_miss(double miss) {
+    if (fd_miss < 0) printf("%12s", "n/a");
+    else             printf("%12.4f", miss);
+}
+
+/*
+   A) 周期性模式：缓冲区由长度为 P 的随机模式平铺而成
+*/
+static void kernel_single(const kernel_arg *g) {
+    for (size_t p = 0; p < g->passes; p++) {
+        for (size_t i = 0; i < g->len; i++) {
+            if (g->a[i]) cnt_t++;
+            else         cnt_n++;
+        }
+    }
+}
+
+static void run_periodic(uint8_t *buf) {
+    printf("A) Periodic pattern length (single branch)\n");
+    printf("%8s  %12s  %12s\n", "Period", "Miss/branch", "Cycles/br");
+    printf("--------------------------------------\n");
+
+    uint8_t *pat = malloc(BUF_LEN);
+    for (size_t period = 2; period <= BUF_LEN; period *= 2) {
+        for (size_t i = 0; i < period; i++) pat[i] = (uint8_t)(rand() & 1);
+        for (size_t i = 0; i < BUF_LEN; i++) buf[i] = pat[i % period];
+
+        kernel_arg g = { buf, NULL, BUF_LEN, TOTAL_BR / BUF_LEN, 0 };
+        double cyc, miss;
+        measure(kernel_single, &g, (double)BUF_LEN * g.passes, &cyc, &miss);
+
+        printf("%8zu  ", period);
+        print_miss(miss);
+        printf("  %12.2f\n", cyc);
+    }
+    free(pat);
+    printf("\n");
+}
+
+/*
+   B) 相关分支距离：随机分支 -> K 个可预测分支 -> 与第一个完全相同的分支
+   只跑前两段作为对照，差值即第二个分支的误预测率
+*/
+static void kernel_filler_only(const kernel_arg *g) {
+    for (size_t p = 0; p < g->passes; p++) {
+        for (size_t i = 0; i < g->len; i++) {
+            if (g->a[i]) cnt_t++;
+            else         cnt_n++;
+            NO_UNROLL
+            for (int k = 0; k < g->k; k++) __asm__ volatile("");
+        }
+    }
+}
+
+static void kernel_correlated(const kernel_arg *g) {
+    for (size_t p = 0; p < g->passes; p++) {
+        for (size_t i = 0; i < g->len; i++) {
+            if (g->a[i]) cnt_t++;
+            else         cnt_n++;
+            NO_UNROLL
+            for (int k = 0; k < g->k; k++) __asm__ volatile("");
+            if (g->b[i]) cnt_t++;
+            else         cnt_n++;
+        }
+    }
+}
+
+static void run_correlated(uint8_t *buf) {
+    printf("B) Correlated branch pair separated by K filler branches\n");
+    printf("%8s  %12s  %12s\n", "K", "2nd miss", "Extra cyc");
+    printf("--------------------------------------\n");
+
+    uint8_t *copy = malloc(BUF_LEN);
+    for (size_t i = 0; i < BUF_LEN; i++) buf[i] = (uint8_t)(rand() & 1);
+    for (size_t i = 0; i < BUF_LEN; i++) copy[i] = buf[i];
+
+    const int ks[] = { 0, 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
+    for (size_t t = 0; t < sizeof(ks) / sizeof(ks[0]); t++) {
+        int k = ks[t];
+        // K 越大每轮越慢，总迭代数随之缩小
+        size_t iters = TOTAL_BR / (size_t)(k + 2);
+        size_t len   = iters < BUF_LEN ? iters : BUF_LEN;
+        size_t passes = iters / len ? iters / len : 1;
+
+        kernel_arg g = { buf, copy, len, passes, k };
+        double units = (double)len * passes;
+        double cyc0, miss0, cyc1, miss1;
+        measure(kernel_filler_only, &g, units, &cyc0, &miss0);
+        measure(kernel_correlated,  &g, units, &cyc1, &miss1);
+
+        printf("%8d  ", k);
+        print_miss(miss1 - miss0);
+        printf("  %12.2f\n", cyc1 - cyc0);
+    }
+    free(copy);
+    printf("(2nd miss ≈ 0 while the first outcome is still in global history, ≈ 0.5 once it falls out)\n\n");
+}
+
+/*
+   C) 同时活跃的静态分支数 M：用宏展开出 M 个不同地址的分支，
+   每个分支看到周期为 SITE_Q 的随机局部模式，总上下文数 ≈ M * SITE_Q
+*/
+#define BR1     if (*p++) cnt_t++; else cnt_n++;
+#define BR2     BR1 BR1
+#define BR4     BR2 BR2
+#define BR8     BR4 BR4
+#define BR16    BR8 BR8
+#define BR32    BR16 BR16
+#define BR64    BR32 BR32
+#define BR128   BR64 BR64
+#define BR256   BR128 BR128
+#define BR512   BR256 BR256
+#define BR1024  BR512 BR512
+
+#define DEF_SITES(M)                                                  \
+    static void kernel_sites_##M(const kernel_arg *g) {               \
+        for (size_t r = 0; r < g->passes; r++) {                      \
+            const uint8_t *p = g->a;                                  \
+            for (size_t i = 0; i < g->len; i += M) { BR##M }          \
+        }                                                             \
+    }
+
+DEF_SITES(1)   DEF_SITES(2)   DEF_SITES(4)   DEF_SITES(8)
+DEF_SITES(16)  DEF_SITES(32)  DEF_SITES(64)  DEF_SITES(128)
+DEF_SITES(256) DEF_SITES(512) DEF_SITES(1024)
+
+static void run_sites(uint8_t *buf) {
+    printf("C) Active static branches (each with a period-%d local pattern)\n", SITE_Q);
+    printf("%8s  %12s  %12s\n", "Sites", "Miss/branch", "Cycles/br");
+    printf("--------------------------------------\n");
+
+    static const struct { int m; branch_kernel fn; } sites[] = {
+        { 1, kernel_sites_1 },     { 2, kernel_sites_2 },     { 4, kernel_sites_4 },
+        { 8, kernel_sites_8 },     { 16, kernel_sites_16 },   { 32, kernel_sites_32 },
+        { 64, kernel_sites_64 },   { 128, kernel_sites_128 }, { 256, kernel_sites_256 },
+        { 512, kernel_sites_512 }, { 1024, kernel_sites_1024 }
+    };
+
+    for (size_t t = 0; t < sizeof(sites) / sizeof(sites[0]); t++) {
+        size_t len = (size_t)sites[t].m * SITE_Q;   // 第 i 轮第 s 个分支读 buf[i*M + s]
+        for (size_t i = 0; i < len; i++) buf[i] = (uint8_t)(rand() & 1);
+
+        kernel_arg g = { buf, NULL, len, TOTAL_BR / len, 0 };
+        double cyc, miss;
+        measure(sites[t].fn, &g, (double)len * g.passes, &cyc, &miss);
+
+        printf("%8d  ", sites[t].m);
+        print_miss(miss);
+        printf("  %12.2f\n", cyc);
+    }
+    printf("\n");
+}
+
+int main(void) {
+    printf("[12] Branch Predictor History & Capacity Test\n");
+    printf("Assumed CPU freq = %.2f GHz, ~%u branches per sample\n", FREQ_GHZ, TOTAL_BR);
+
+    fd_miss = hw_counter_open(HW_BRANCH_MISSES);
+    if (fd_miss < 0)
+        printf("NOTE: branch-miss counter unavailable, reporting cycles only.\n");
+    printf("\n");
+
+    uint8_t *buf = malloc(BUF_LEN);
+    if (!buf) {
+        fprintf(stderr, "malloc failed\n");
+        return 1;
+    }
+
+    run_periodic(buf);
+    run_correlated(buf);
+    run_sites(buf);
+
+    free(buf);
+    hw_counter_close(fd_miss);
+    return 0;
+}
@@ -0,0 +1,374 @@
+// 013_indirect_branch.c
+// 实验目的：测试间接控制流相关的前端结构（BTB / 间接分支预测器 / RSB）
+// 方法：
+//   A) 运行时生成 N 个连续的无条件跳转（间距 S 字节），N 超过 BTB 容量后每次跳转变慢
+//   B) 通过 switch 跳表、computed goto（threaded dispatch）和 if-else 分支链三种方式分发
+//      T 个目标，操作码序列分为 固定 / 循环 / 随机 三种模式
+//   C) 递归深度 D 的 call/ret，D 超过返回栈缓冲区 (RSB) 深度后 ret 开始误预测
+// 沿用 05_branch_penalty.c 的做法：取中位数，按假定主频换算为周期
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "harness.h"
+
+#if defined(__APPLE__)
+  #include <pthread.h>
+  #include <libkern/OSCacheControl.h>
+#endif
+
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+#define REPEAT    9
+#define FREQ_GHZ  3.2
+#define JIT_BYTES (1u << 20)        // 代码缓冲区 1 MiB
+#define SEQ_LEN   4096              // B 部分操作码序列长度
+#define TOTAL_OPS (4u << 20)        // 每次测量约 4M 次跳转/分发
+
+static int fd_miss = -1;
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+static void print_miss(double miss) {
+    if (fd_miss < 0) printf("%12s", "n/a");
+    else             printf("%12.4f", miss);
+}
+
+/*
+   A) BTB 容量：运行时生成跳转链
+*/
+
+// 申请可执行内存（macOS arm64 需要 MAP_JIT + 写保护切换）
+static uint8_t *jit_alloc(size_t bytes) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(__APPLE__)
+    flags |= MAP_JIT;
+#endif
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE | PROT_EXEC, flags, -1, 0);
+    return (p == MAP_FAILED) ? NULL : (uint8_t *)p;
+}
+
+static void jit_begin_write(void) {
+#if defined(__APPLE__)
+    pthread_jit_write_protect_np(0);
+#endif
+}
+
+static void jit_end_write(uint8_t *code, size_t bytes) {
+#if defined(__APPLE__)
+    pthread_jit_write_protect_np(1);
+    sys_icache_invalidate(code, bytes);
+#else
+    __builtin___clear_cache((char *)code, (char *)code + bytes);
+#endif
+}
+
+// 生成 n 个间距为 spacing 的 taken 跳转，最后一条为 ret；返回 0 表示当前架构不支持
+static int emit_jump_chain(uint8_t *code, size_t n, size_t spacing) {
+#if defined(__x86_64__)
+    memset(code, 0x90, n * spacing + 16);          // 空隙填 nop（实际不会执行）
+    for (size_t i = 0; i < n; i++) {
+        uint8_t *at = code + i * spacing;
+        if (i + 1 == n) {
+            at[0] = 0xC3;                           // ret
+        } else {
+            int32_t rel = (int32_t)(spacing - 5);   // jmp rel32 到下一个槽位
+            at[0] = 0xE9;
+            memcpy(at + 1, &rel, 4);
+        }
+    }
+    return 1;
+#elif defined(__aarch64__)
+    uint32_t *w = (uint32_t *)code;
+    for (size_t i = 0; i < n * spacing / 4; i++) w[i] = 0xD503201F;  // nop
+    for (size_t i = 0; i < n; i++) {
+        uint32_t *at = (uint32_t *)(code + i * spacing);
+        if (i + 1 == n) *at = 0xD65F03C0;                             // ret
+        else            *at = 0x14000000u | (uint32_t)((spacing / 4) & 0x3FFFFFF);  // b +spacing
+    }
+    return 1;
+#else
+    (void)code; (void)n; (void)spacing;
+    return 0;
+#endif
+}
+
+static double measure_jump_chain(uint8_t *code, size_t n) {
+    double samples[REPEAT];
+    uint64_t t_oh = timer_overhead_ns();
+    void (*chain)(void) = (void (*)(void))code;
+    size_t reps = TOTAL_OPS / n;
+    if (reps < 16) reps = 16;
+
+    for (size_t i = 0; i < reps; i++) chain();   // 预热 BTB
+
+    for (int r = 0; r < REPEAT; r++) {
+        warmup_busy_loop(20000);
+
+        uint64_t t0 = now_ns();
+        for (size_t i = 0; i < reps; i++) chain();
+        uint64_t t1 = now_ns();
+
+        double ns = (double)(int64_t)(t1 - t0 - t_oh);
+        if (ns < 0) ns = 0;
+        samples[r] = ns * FREQ_GHZ / (double)(reps * n);
+    }
+    return median(samples, REPEAT);
+}
+
+static void run_btb(void) {
+#if defined(__x86_64__)
+    const size_t spacings[] = { 8, 16, 32, 64 };
+#else
+    const size_t spacings[] = { 4, 16, 32, 64 };
+#endif
+    const size_t NS = sizeof(spacings) / sizeof(spacings[0]);
+
+    printf("A) BTB capacity: chain of N taken jumps (cycles per jump)\n");
+
+    uint8_t *code = jit_alloc(JIT_BYTES);
+    if (!code) {
+        printf("   executable mmap failed, skipped\n\n");
+        return;
+    }
+
+    printf("%8s", "N");
+    for (size_t s = 0; s < NS; s++) printf("  %8zuB", spacings[s]);
+    printf("\n-----------------------------------------------\n");
+
+    for (size_t n = 16; n <= 16384; n *= 2) {
+        printf("%8zu", n);
+        for (size_t s = 0; s < NS; s++) {
+            if (n * spacings[s] + 16 > JIT_BYTES) {
+                printf("  %9s", "-");
+                continue;
+            }
+            jit_begin_write();
+            int ok = emit_jump_chain(code, n, spacings[s]);
+            jit_end_write(code, n * spacings[s] + 16);
+            if (!ok) {
+                printf("\n   unsupported architecture, skipped\n\n");
+                munmap(code, JIT_BYTES);
+                return;
+            }
+            printf("  %9.2f", measure_jump_chain(code, n));
+        }
+        printf("\n");
+    }
+    munmap(code, JIT_BYTES);
+    printf("\n");
+}
+
+/*
+   B) 间接分发：64 个 handler，操作码只取 0..T-1
+   每个 handler 里放一条 asm 屏障，防止编译器把 switch 改写成查表运算
+*/
+#define OPCODES(X) \
+    X(0)  X(1)  X(2)  X(3)  X(4)  X(5)  X(6)  X(7)  \
+    X(8)  X(9)  X(10) X(11) X(12) X(13) X(14) X(15) \
+    X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23) \
+    X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31) \
+    X(32) X(33) X(34) X(35) X(36) X(37) X(38) X(39) \
+    X(40) X(41) X(42) X(43) X(44) X(45) X(46) X(47) \
+    X(48) X(49) X(50) X(51) X(52) X(53) X(54) X(55) \
+    X(56) X(57) X(58) X(59) X(60) X(61) X(62) X(63)
+#define MAX_TARGETS 64
+
+#define HANDLER_BODY(k) { acc += (k) * 0x9E3779B1u; __asm__ volatile("" : "+r"(acc)); }
+
+static volatile uint64_t sink;
+
+// 单一分发点：switch（编译为跳表 + 一条间接跳转）
+static NOINLINE void dispatch_switch(const uint8_t *ops, size_t len, size_t passes) {
+    uint64_t acc = 0;
+    for (size_t p = 0; p < passes; p++) {
+        for (size_t i = 0; i < len; i++) {
+            switch (ops[i]) {
+#define CASE_SWITCH(k) case k: HANDLER_BODY(k) break;
+                OPCODES(CASE_SWITCH)
+#undef CASE_SWITCH
+            }
+        }
+    }
+    sink = acc;
+}
+
+// 分散分发点：computed goto，每个 handler 末尾各有一条间接跳转
+static NOINLINE void dispatch_goto(const uint8_t *ops, size_t len, size_t passes) {
+#define LABEL_ADDR(k) &&op_##k,
+    static void *table[MAX_TARGETS + 1] = { OPCODES(LABEL_ADDR) &&op_end };
+#undef LABEL_ADDR
+    uint64_t acc = 0;
+    for (size_t p = 0; p < passes; p++) {
+        // 在序列末尾放一个 “end” 操作码，跳出当前遍
+        const uint8_t *ip = ops;
+        const uint8_t *end = ops + len;
+#define NEXT() do { if (ip == end) goto op_end; goto *table[*ip++]; } while (0)
+        NEXT();
+#define LABEL_GOTO(k) op_##k: HANDLER_BODY(k) NEXT();
+        OPCODES(LABEL_GOTO)
+#undef LABEL_GOTO
+#undef NEXT
+    op_end:
+        ;
+    }
+    sink = acc;
+}
+
+// if-else 分支链：asm 屏障让编译器无法把链合并成跳表
+static NOINLINE void dispatch_chain(const uint8_t *ops, size_t len, size_t passes) {
+    uint64_t acc = 0;
+    for (size_t p = 0; p < passes; p++) {
+        for (size_t i = 0; i < len; i++) {
+            uint32_t op = ops[i];
+#define CASE_CHAIN(k) __asm__ volatile("" : "+r"(op)); if (op == k) { HANDLER_BODY(k) continue; }
+            OPCODES(CASE_CHAIN)
+#undef CASE_CHAIN
+        }
+    }
+    sink = acc;
+}
+
+typedef void (*dispatch_fn)(const uint8_t *, size_t, size_t);
+
+static void measure_dispatch(dispatch_fn fn, const uint8_t *ops, double *cyc_out, double *miss_out) {
+    double cyc[REPEAT], miss[REPEAT];
+    uint64_t t_oh = timer_overhead_ns();
+    size_t passes = TOTAL_OPS / SEQ_LEN;
+
+    fn(ops, SEQ_LEN, passes);   // 训练
+
+    for (int r = 0; r < REPEAT; r++) {
+        warmup_busy_loop(20000);
+
+        uint64_t m0 = hw_counter_read(fd_miss);
+        uint64_t t0 = now_ns();
+        fn(ops, SEQ_LEN, passes);
+        uint64_t t1 = now_ns();
+        uint64_t m1 = hw_counter_read(fd_miss);
+
+        double ns = (double)(int64_t)(t1 - t0 - t_oh);
+        if (ns < 0) ns = 0;
+        double n_ops = (double)SEQ_LEN * passes;
+        cyc[r]  = ns * FREQ_GHZ / n_ops;
+        miss[r] = (double)(m1 - m0) / n_ops;
+    }
+    *cyc_out  = median(cyc, REPEAT);
+    *miss_out = median(miss, REPEAT);
+}
+
+static void run_dispatch(void) {
+    static const char *pattern_names[] = { "fixed", "cyclic", "random" };
+    static const struct { const char *name; dispatch_fn fn; } impls[] = {
+        { "switch", dispatch_switch },
+        { "goto",   dispatch_goto   },
+        { "chain",  dispatch_chain  },
+    };
+
+    printf("B) Indirect dispatch over T targets (cycles / miss per dispatch)\n");
+    printf("%-7s %4s", "Pattern", "T");
+    for (size_t m = 0; m < 3; m++) printf("  %10s %12s", impls[m].name, "miss");
+    printf("\n--------------------------------------------------------------------------------------\n");
+
+    uint8_t *ops = malloc(SEQ_LEN);
+    for (int pat = 0; pat < 3; pat++) {
+        for (int t = 1; t <= MAX_TARGETS; t *= 2) {
+            for (size_t i = 0; i < SEQ_LEN; i++) {
+                if (pat == 0)      ops[i] = (uint8_t)(t - 1);
+                else if (pat == 1) ops[i] = (uint8_t)(i % t);
+                else               ops[i] = (uint8_t)(rand() % t);
+            }
+            printf("%-7s %4d", pattern_names[pat], t);
+            for (size_t m = 0; m < 3; m++) {
+                double cyc, miss;
+                measure_dispatch(impls[m].fn, ops, &cyc, &miss);
+                printf("  %10.2f ", cyc);
+                print_miss(miss);
+            }
+            printf("\n");
+        }
+    }
+    free(ops);
+    printf("\n");
+}
+
+/*
+   C) RSB 深度：递归 D 层再逐层返回
+   调用后的 asm 屏障阻止编译器把递归改写成循环
+*/
+static NOINLINE uint64_t recurse(int depth) {
+    if (depth == 0) return 1;
+    uint64_t r = recurse(depth - 1);
+    __asm__ volatile("" : "+r"(r));
+    return r + 1;
+}
+
+static void run_rsb(void) {
+    printf("C) Return stack buffer: recursion depth D\n");
+    printf("%8s  %12s  %12s\n", "Depth", "Cyc/call+ret", "Miss/ret");
+    printf("--------------------------------------\n");
+
+    for (int d = 1; d <= 128; d *= 2) {
+        double cyc[REPEAT], miss[REPEAT];
+        uint64_t t_oh = timer_overhead_ns();
+        size_t reps = TOTAL_OPS / (size_t)d;
+
+        for (size_t i = 0; i < 1000; i++) sink = recurse(d);
+
+        for (int r = 0; r < REPEAT; r++) {
+            warmup_busy_loop(20000);
+
+            uint64_t m0 = hw_counter_read(fd_miss);
+            uint64_t t0 = now_ns();
+            for (size_t i = 0; i < reps; i++) sink = recurse(d);
+            uint64_t t1 = now_ns();
+            uint64_t m1 = hw_counter_read(fd_miss);
+
+            double ns = (double)(int64_t)(t1 - t0 - t_oh);
+            if (ns < 0) ns = 0;
+            double calls = (double)reps * (d + 1);
+            cyc[r]  = ns * FREQ_GHZ / calls;
+            miss[r] = (double)(m1 - m0) / calls;
+        }
+        printf("%8d  %12.2f  ", d, median(cyc, REPEAT));
+        print_miss(median(miss, REPEAT));
+        printf("\n");
+    }
+    printf("\n");
+}
+
+int main(void) {
+    printf("[13] BTB / Indirect Branch / Return Stack Buffer Test\n");
+    printf("Assumed CPU freq = %.2f GHz\n", FREQ_GHZ);
+
+    fd_miss = hw_counter_open(HW_BRANCH_MISSES);
+    if (fd_miss < 0)
+        printf("NOTE: branch-miss counter unavailable, reporting cycles only.\n");
+    printf("\n");
+
+    run_btb();
+    run_dispatch();
+    run_rsb();
+
+    hw_counter_close(fd_miss);
+    return 0;
+}
@@ -0,0 +1,241 @@
+// 014_call_overhead.c
+// 实验目的：比较不同调用方式的开销（00_function_call.c 的扩展）
+// 方法：每种调用方式各生成两个循环
+//   延迟 (latency)   ：x = f(x)，后一次调用依赖前一次返回值
+//   吞吐 (throughput)：acc += f(i)，调用之间没有数据依赖
+// 再减去同结构但不调用函数的基线循环，得到每次调用的净开销
+// 覆盖：直接调用 / 函数指针间接调用 / 跨共享库 (PLT) / 虚函数（C 中以 vtable 模拟）/
+//       栈上传参 / 结构体按值返回 / 不同递归深度
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "harness.h"
+
+// gcc 的 noipa 同时禁止常量传播克隆等过程间优化；clang 对外部可见函数不做这类改写
+#if defined(__clang__)
+#define NOINLINE __attribute__((noinline))
+#elif defined(__GNUC__)
+#define NOINLINE __attribute__((noinline, noipa))
+#else
+#define NOINLINE
+#endif
+
+#define REPEAT   11
+#define FREQ_GHZ 3.2
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+// -------- 被调函数（非 static，避免被改签名） --------
+
+// 来自 bin/libcallee.so
+extern uint64_t dso_inc(uint64_t x);
+
+NOINLINE uint64_t inc1(uint64_t a) { return a + 1; }
+
+NOINLINE uint64_t inc6(uint64_t a, uint64_t b, uint64_t c,
+                       uint64_t d, uint64_t e, uint64_t f) {
+    return a + b + c + d + e + f;
+}
+
+// SysV x86-64 前 6 个、AArch64 前 8 个整数参数走寄存器，其余入栈
+NOINLINE uint64_t inc10(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e,
+                        uint64_t f, uint64_t g, uint64_t h, uint64_t i, uint64_t j) {
+    return a + b + c + d + e + f + g + h + i + j;
+}
+
+NOINLINE uint64_t inc16(uint64_t a, uint64_t b, uint64_t c, uint64_t d,
+                        uint64_t e, uint64_t f, uint64_t g, uint64_t h,
+                        uint64_t i, uint64_t j, uint64_t k, uint64_t l,
+                        uint64_t m, uint64_t n, uint64_t o, uint64_t p) {
+    return a + b + c + d + e + f + g + h + i + j + k + l + m + n + o + p;
+}
+
+// 结构体按值返回：16B 用寄存器返回，32B/64B 通过调用者提供的内存返回
+typedef struct { uint64_t v[2]; } ret16;
+typedef struct { uint64_t v[4]; } ret32;
+typedef struct { uint64_t v[8]; } ret64;
+
+NOINLINE ret16 make16(uint64_t x) { ret16 r = {{ x, x + 1 }}; return r; }
+NOINLINE ret32 make32(uint64_t x) { ret32 r = {{ x, x, x, x + 1 }}; return r; }
+NOINLINE ret64 make64(uint64_t x) { ret64 r = {{ x, x, x, x, x, x, x, x + 1 }}; return r; }
+
+// 递归：每层一次 call + ret，调用后的 asm 屏障防止被改写成循环
+NOINLINE uint64_t recurse(int depth, uint64_t x) {
+    if (depth == 0) return x + 1;
+    uint64_t r = recurse(depth - 1, x);
+    __asm__ volatile("" : "+r"(r));
+    return r;
+}
+
+// 函数指针：通过 volatile 读出，编译器无法去虚化
+static uint64_t (*volatile fp_inc)(uint64_t) = inc1;
+
+// 虚函数：C++ 的 obj->f(x) 编译为 “取 vptr -> 取槽位 -> 间接调用”，这里按同样布局手写
+typedef struct object object;
+typedef struct {
+    uint64_t (*inc)(const object *self, uint64_t x);
+} vtable;
+struct object {
+    const vtable *vptr;
+    uint64_t      bias;
+};
+
+NOINLINE uint64_t object_inc(const object *self, uint64_t x) { return x + self->bias; }
+
+static const vtable  object_vtable = { object_inc };
+static object        the_object    = { &object_vtable, 1 };
+static object *volatile obj_ptr    = &the_object;
+
+// -------- 循环内核：每种调用方式一对 latency / throughput --------
+
+// 基线：不调用，只做一次编译器看不穿的 +1
+static inline uint64_t opaque_inc(uint64_t v) {
+    __asm__ volatile("" : "+r"(v));
+    return v + 1;
+}
+
+#define CALL_NONE(a)     opaque_inc(a)
+#define CALL_DIRECT(a)   inc1(a)
+#define CALL_INDIRECT(a) fp_inc(a)
+#define CALL_PLT(a)      dso_inc(a)
+#define CALL_VIRTUAL(a)  (obj->vptr->inc(obj, (a)))
+#define CALL_ARGS6(a)    inc6((a), 1, 2, 3, 4, 5)
+#define CALL_ARGS10(a)   inc10((a), 1, 2, 3, 4, 5, 6, 7, 8, 9)
+#define CALL_ARGS16(a)   inc16((a), 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)
+#define CALL_RET16(a)    make16(a).v[1]
+#define CALL_RET32(a)    make32(a).v[3]
+#define CALL_RET64(a)    make64(a).v[7]
+
+#define DEF_KERNELS(name, CALL)                                   \
+    static NOINLINE uint64_t lat_##name(size_t n) {               \
+        const object *obj = obj_ptr; (void)obj;                   \
+        uint64_t x = 1;                                           \
+        for (size_t i = 0; i < n; i++) x = CALL(x);               \
+        return x;                                                 \
+    }                                                             \
+    static NOINLINE uint64_t thr_##name(size_t n) {               \
+        const object *obj = obj_ptr; (void)obj;                   \
+        uint64_t acc = 0;                                         \
+        for (size_t i = 0; i < n; i++) acc += CALL(i);            \
+        return acc;                                               \
+    }
+
+DEF_KERNELS(none,     CALL_NONE)
+DEF_KERNELS(direct,   CALL_DIRECT)
+DEF_KERNELS(indirect, CALL_INDIRECT)
+DEF_KERNELS(plt,      CALL_PLT)
+DEF_KERNELS(virtual,  CALL_VIRTUAL)
+DEF_KERNELS(args6,    CALL_ARGS6)
+DEF_KERNELS(args10,   CALL_ARGS10)
+DEF_KERNELS(args16,   CALL_ARGS16)
+DEF_KERNELS(ret16,    CALL_RET16)
+DEF_KERNELS(ret32,    CALL_RET32)
+DEF_KERNELS(ret64,    CALL_RET64)
+
+typedef uint64_t (*loop_kernel)(size_t);
+
+static volatile uint64_t sink;
+
+// 返回一次循环迭代的中位耗时（ns）
+static double time_per_iter_ns(loop_kernel fn, size_t iters) {
+    double samples[REPEAT];
+    const uint64_t tovh = timer_overhead_ns();
+
+    for (size_t r = 0; r < REPEAT; ++r) {
+        warmup_busy_loop(100000);
+
+        uint64_t t0 = now_ns();
+        sink = fn(iters);
+        uint64_t t1 = now_ns();
+
+        int64_t dt = (int64_t)(t1 - t0) - (int64_t)tovh;
+        if (dt < 0) dt = 0;
+        samples[r] = (double)dt / (double)iters;
+    }
+    return median(samples, REPEAT);
+}
+
+static void report(const char *label, double lat_ns, double thr_ns) {
+    if (lat_ns < 0) lat_ns = 0;
+    if (thr_ns < 0) thr_ns = 0;
+    printf("  %-22s %10.3f %10.3f %10.2f %10.2f\n",
+           label, lat_ns, thr_ns, lat_ns * FREQ_GHZ, thr_ns * FREQ_GHZ);
+}
+
+int main(void) {
+    const size_t N = 10 * 1000 * 1000ull;
+
+    printf("[14] Extended Function Call Overhead, N=%zu\n", N);
+    printf("Assumed CPU freq = %.2f GHz, baseline loop subtracted\n\n", FREQ_GHZ);
+    printf("  %-22s %10s %10s %10s %10s\n", "Variant", "Lat(ns)", "Thru(ns)", "Lat(cyc)", "Thru(cyc)");
+    printf("  ------------------------------------------------------------------\n");
+
+    double base_lat = time_per_iter_ns(lat_none, N);
+    double base_thr = time_per_iter_ns(thr_none, N);
+
+    static const struct {
+        const char *label;
+        loop_kernel lat, thr;
+    } variants[] = {
+        { "direct",              lat_direct,   thr_direct   },
+        { "indirect (fn ptr)",   lat_indirect, thr_indirect },
+        { "shared lib (PLT)",    lat_plt,      thr_plt      },
+        { "virtual (vtable)",    lat_virtual,  thr_virtual  },
+        { "6 args",              lat_args6,    thr_args6    },
+        { "10 args (stack)",     lat_args10,   thr_args10   },
+        { "16 args (stack)",     lat_args16,   thr_args16   },
+        { "return 16B struct",   lat_ret16,    thr_ret16    },
+        { "return 32B struct",   lat_ret32,    thr_ret32    },
+        { "return 64B struct",   lat_ret64,    thr_ret64    },
+    };
+
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        double lat = time_per_iter_ns(variants[v].lat, N) - base_lat;
+        double thr = time_per_iter_ns(variants[v].thr, N) - base_thr;
+        report(variants[v].label, lat, thr);
+    }
+
+    // 递归：每次外层调用包含 depth+1 次 call/ret，按单次调用折算
+    printf("\n  Recursion (per call, depth = frames per outer call)\n");
+    for (int depth = 1; depth <= 256; depth *= 4) {
+        double samples_lat[REPEAT], samples_thr[REPEAT];
+        size_t outer = N / (size_t)(depth + 1);
+        const uint64_t tovh = timer_overhead_ns();
+
+        for (size_t r = 0; r < REPEAT; ++r) {
+            warmup_busy_loop(100000);
+
+            uint64_t x = 1, acc = 0;
+            uint64_t t0 = now_ns();
+            for (size_t i = 0; i < outer; i++) x = recurse(depth, x);
+            uint64_t t1 = now_ns();
+            for (size_t i = 0; i < outer; i++) acc += recurse(depth, i);
+            uint64_t t2 = now_ns();
+            sink = x + acc;
+
+            double calls = (double)outer * (depth + 1);
+            samples_lat[r] = ((double)(t1 - t0) - tovh) / calls;
+            samples_thr[r] = ((double)(t2 - t1) - tovh) / calls;
+        }
+
+        char label[32];
+        snprintf(label, sizeof(label), "depth %d", depth);
+        report(label, median(samples_lat, REPEAT), median(samples_thr, REPEAT));
+    }
+
+    return 0;
+}
+
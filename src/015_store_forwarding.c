@@ -0,0 +1,292 @@
+// 015_store_forwarding.c
+// 实验目的：测量非理想访存模式的代价（04_load_store_throughput.c 只测了对齐、无冲突的情况）
+// 方法：
+//   A) store-to-load forwarding：store -> load -> 下一次 store 形成依赖链，
+//      改变 store/load 宽度和偏移，观察何时转发失败（例如窄 store 后宽 load）
+//   B) 跨 cache line / 跨页的非对齐 load 与 store 吞吐
+//   C) 4K aliasing：load 地址与之前 store 地址低 12 位相同（但不是同一地址）
+//   D) 内存消歧 (memory disambiguation)：store 地址计算很慢、load 地址很快，
+//      load 是否真的与 store 重叠分为 从不 / 总是 / 随机 三种情况
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "harness.h"
+
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+// 编译器内存屏障：强制真正写回内存再读出，但不产生任何指令
+#define COMPILER_BARRIER() __asm__ volatile("" ::: "memory")
+
+#define REPEAT   11
+#define FREQ_GHZ 3.2
+#define ITERS    (4u << 20)
+#define PAGE     4096
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+typedef uint64_t (*mem_kernel)(uint8_t *buf, size_t n, size_t param);
+
+static volatile uint64_t sink;
+
+// 对 kernel 计时，返回每次迭代的周期数
+static double cycles_per_iter(mem_kernel fn, uint8_t *buf, size_t param) {
+    double samples[REPEAT];
+    uint64_t t_oh = timer_overhead_ns();
+
+    sink = fn(buf, ITERS / 16, param);   // 预热：页表、cache、预测器
+
+    for (int r = 0; r < REPEAT; r++) {
+        warmup_busy_loop(20000);
+
+        uint64_t t0 = now_ns();
+        sink = fn(buf, ITERS, param);
+        uint64_t t1 = now_ns();
+
+        double ns = (double)(int64_t)(t1 - t0 - t_oh);
+        if (ns < 0) ns = 0;
+        samples[r] = ns * FREQ_GHZ / (double)ITERS;
+    }
+    return median(samples, REPEAT);
+}
+
+/*
+   A) store-to-load forwarding 延迟
+   x -> store(ST_T @ ST_OFF) -> load(LD_T @ LD_OFF) -> x，循环携带依赖
+*/
+#define DEF_FWD(name, ST_T, ST_OFF, LD_T, LD_OFF)                         \
+    static NOINLINE uint64_t fwd_##name(uint8_t *buf, size_t n, size_t p) { \
+        (void)p;                                                          \
+        uint64_t x = 0;                                                   \
+        for (size_t i = 0; i < n; i++) {                                  \
+            ST_T s = (ST_T)x;                                             \
+            memcpy(buf + (ST_OFF), &s, sizeof(s));                        \
+            COMPILER_BARRIER();                                           \
+            LD_T l;                                                       \
+            memcpy(&l, buf + (LD_OFF), sizeof(l));                        \
+            x = (uint64_t)l;                                              \
+        }                                                                 \
+        return x;                                                         \
+    }
+
+DEF_FWD(s8_l8,        uint64_t, 0,  uint64_t, 0)    // 完全相同
+DEF_FWD(s8_l4_lo,     uint64_t, 0,  uint32_t, 0)    // 宽 store，窄 load 低半
+DEF_FWD(s8_l4_hi,     uint64_t, 0,  uint32_t, 4)    // 宽 store，窄 load 高半
+DEF_FWD(s8_l1_7,      uint64_t, 0,  uint8_t,  7)    // 宽 store，取最后一个字节
+DEF_FWD(s8_l2_3,      uint64_t, 0,  uint16_t, 3)    // 宽 store，非对齐窄 load
+DEF_FWD(s4_l8,        uint32_t, 0,  uint64_t, 0)    // 窄 store，宽 load（部分覆盖）
+DEF_FWD(s1_l8,        uint8_t,  0,  uint64_t, 0)    // 1B store，8B load
+DEF_FWD(s8_l8_off1,   uint64_t, 0,  uint64_t, 1)    // 错开 1 字节的部分重叠
+DEF_FWD(s8_l8_mis,    uint64_t, 3,  uint64_t, 3)    // 同地址但非对齐
+DEF_FWD(s8_l8_split,  uint64_t, 60, uint64_t, 60)   // 同地址但跨 cache line
+DEF_FWD(s8_l4_split,  uint64_t, 60, uint32_t, 64)   // 跨行 store，取第二行那一半
+
+// 两个 4B store 拼成一个 8B load
+static NOINLINE uint64_t fwd_2x4_l8(uint8_t *buf, size_t n, size_t p) {
+    (void)p;
+    uint64_t x = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t lo = (uint32_t)x, hi = (uint32_t)(x >> 32);
+        memcpy(buf, &lo, 4);
+        COMPILER_BARRIER();            // 防止两次 store 被合并成一次 8B store
+        memcpy(buf + 4, &hi, 4);
+        COMPILER_BARRIER();
+        memcpy(&x, buf, 8);
+    }
+    return x;
+}
+
+static void run_forwarding(uint8_t *buf) {
+    static const struct { const char *label; mem_kernel fn; } cases[] = {
+        { "st8 @0   -> ld8 @0",   fwd_s8_l8 },
+        { "st8 @0   -> ld4 @0",   fwd_s8_l4_lo },
+        { "st8 @0   -> ld4 @4",   fwd_s8_l4_hi },
+        { "st8 @0   -> ld1 @7",   fwd_s8_l1_7 },
+        { "st8 @0   -> ld2 @3",   fwd_s8_l2_3 },
+        { "st8 @3   -> ld8 @3",   fwd_s8_l8_mis },
+        { "st8 @60  -> ld8 @60",  fwd_s8_l8_split },
+        { "st8 @60  -> ld4 @64",  fwd_s8_l4_split },
+        { "st4 @0   -> ld8 @0",   fwd_s4_l8 },
+        { "st1 @0   -> ld8 @0",   fwd_s1_l8 },
+        { "st8 @0   -> ld8 @1",   fwd_s8_l8_off1 },
+        { "2x st4   -> ld8 @0",   fwd_2x4_l8 },
+    };
+
+    printf("A) Store-to-load forwarding latency (store -> load -> store chain)\n");
+    printf("  %-22s %12s\n", "Case", "Cycles/iter");
+    printf("  -----------------------------------\n");
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+        printf("  %-22s %12.2f\n", cases[c].label, cycles_per_iter(cases[c].fn, buf, 0));
+    printf("  (first rows forward successfully; a jump of ~10+ cycles means the load waited for the store to commit)\n\n");
+}
+
+/*
+   B) 非对齐 / 跨行 / 跨页访问吞吐：8 个独立访问分布在 8 个不同行（或页）上
+   param = (间距 << 16) | 偏移
+*/
+static NOINLINE uint64_t split_loads(uint8_t *buf, size_t n, size_t param) {
+    size_t stride = param >> 16, off = param & 0xFFFF;
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0, s4 = 0, s5 = 0, s6 = 0, s7 = 0;
+    uint8_t *p = buf + off;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t v0, v1, v2, v3, v4, v5, v6, v7;
+        memcpy(&v0, p + 0 * stride, 8); memcpy(&v1, p + 1 * stride, 8);
+        memcpy(&v2, p + 2 * stride, 8); memcpy(&v3, p + 3 * stride, 8);
+        memcpy(&v4, p + 4 * stride, 8); memcpy(&v5, p + 5 * stride, 8);
+        memcpy(&v6, p + 6 * stride, 8); memcpy(&v7, p + 7 * stride, 8);
+        s0 += v0; s1 += v1; s2 += v2; s3 += v3;
+        s4 += v4; s5 += v5; s6 += v6; s7 += v7;
+        COMPILER_BARRIER();
+    }
+    return s0 + s1 + s2 + s3 + s4 + s5 + s6 + s7;
+}
+
+static NOINLINE uint64_t split_stores(uint8_t *buf, size_t n, size_t param) {
+    size_t stride = param >> 16, off = param & 0xFFFF;
+    uint8_t *p = buf + off;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t v = i;
+        memcpy(p + 0 * stride, &v, 8); memcpy(p + 1 * stride, &v, 8);
+        memcpy(p + 2 * stride, &v, 8); memcpy(p + 3 * stride, &v, 8);
+        memcpy(p + 4 * stride, &v, 8); memcpy(p + 5 * stride, &v, 8);
+        memcpy(p + 6 * stride, &v, 8); memcpy(p + 7 * stride, &v, 8);
+        COMPILER_BARRIER();
+    }
+    return 0;
+}
+
+static void run_split(uint8_t *buf) {
+    static const struct { const char *label; size_t stride, off; } cases[] = {
+        { "aligned (off 0)",        128,  0 },
+        { "misaligned in line (1)", 128,  1 },
+        { "line split (off 60)",    128,  60 },
+        { "page aligned (off 0)",   PAGE, 0 },
+        { "page split (off 4092)",  PAGE, PAGE - 4 },
+    };
+
+    printf("B) Misaligned / split 8-byte accesses (8 independent per iteration)\n");
+    printf("  %-24s %12s %12s\n", "Case", "Load cyc", "Store cyc");
+    printf("  ----------------------------------------------------\n");
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        size_t param = (cases[c].stride << 16) | cases[c].off;
+        double ld = cycles_per_iter(split_loads,  buf, param) / 8.0;
+        double st = cycles_per_iter(split_stores, buf, param) / 8.0;
+        printf("  %-24s %12.2f %12.2f\n", cases[c].label, ld, st);
+    }
+    printf("  (cycles per access)\n\n");
+}
+
+/*
+   C) 4K aliasing：每次迭代先 store 到 S + slot，再从 S + D + slot load，两者互不依赖
+   slot 每次前进 8B，所以 D 略小于 4096 的倍数时，load 与几次迭代前的 store 低 12 位相同，
+   会被误判为依赖那次 store
+*/
+static NOINLINE uint64_t alias_kernel(uint8_t *buf, size_t n, size_t dist) {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t slot = (i & 63) * 8;
+        uint64_t v = i, l;
+        memcpy(buf + slot, &v, 8);
+        memcpy(&l, buf + dist + slot, 8);
+        acc += l;
+        COMPILER_BARRIER();
+    }
+    return acc;
+}
+
+static void run_4k_alias(uint8_t *buf) {
+    const size_t dists[] = { 2048, 3840, 4032, 4064, 4088, 4096, 4104, 4160, 8128, 8192 };
+
+    printf("C) 4K aliasing: store to S, then independent load from S + D\n");
+    printf("  %10s %12s\n", "D (bytes)", "Cycles/iter");
+    printf("  -----------------------\n");
+    for (size_t d = 0; d < sizeof(dists) / sizeof(dists[0]); d++)
+        printf("  %10zu %12.2f\n", dists[d], cycles_per_iter(alias_kernel, buf, dists[d]));
+    printf("\n");
+}
+
+/*
+   D) 内存消歧：store 地址要等一串乘法（慢），load 地址直接查表（快）
+   st_idx / ld_idx 决定两者是否真的重叠
+*/
+#define DIS_LEN 4096
+static uint32_t st_idx[DIS_LEN], ld_idx[DIS_LEN];
+static volatile uint64_t zero_factor = 0;   // 乘积恒为 0，但编译器不知道
+#define OPAQUE(x) __asm__ volatile("" : "+r"(x))    // 切断编译器对乘法链的化简
+
+static NOINLINE uint64_t disambig_kernel(uint8_t *buf, size_t n, size_t p) {
+    (void)p;
+    uint64_t *slots = (uint64_t *)buf;
+    uint64_t z = zero_factor, acc = 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t k = i & (DIS_LEN - 1);
+        // 4 次乘法后地址才确定；每步前加空 asm，否则编译器会把 z^4 提到循环外、i * z^4 化简成随 i 递增的加法
+        uint64_t t = i;
+        OPAQUE(t); t *= z;
+        OPAQUE(t); t *= z;
+        OPAQUE(t); t *= z;
+        OPAQUE(t); t *= z;
+        OPAQUE(t);
+        size_t late = st_idx[k] + (size_t)t;
+        slots[late] = i;
+        acc += slots[ld_idx[k]];
+        COMPILER_BARRIER();
+    }
+    return acc;
+}
+
+static void run_disambiguation(uint8_t *buf) {
+    static const char *names[] = { "never alias", "always alias", "alias 50% random" };
+
+    printf("D) Memory disambiguation (slow store address, fast load address)\n");
+    printf("  %-20s %12s\n", "Pattern", "Cycles/iter");
+    printf("  ---------------------------------\n");
+    for (int pat = 0; pat < 3; pat++) {
+        for (size_t k = 0; k < DIS_LEN; k++) {
+            st_idx[k] = (uint32_t)((k & 15) * 8);           // 每个槽位占一行
+            int alias = (pat == 1) || (pat == 2 && (rand() & 1));
+            ld_idx[k] = alias ? st_idx[k] : st_idx[k] + 4;
+        }
+        printf("  %-20s %12.2f\n", names[pat], cycles_per_iter(disambig_kernel, buf, 0));
+    }
+    printf("\n");
+}
+
+int main(void) {
+    printf("[15] Store Forwarding / Misaligned Access / 4K Aliasing Test\n");
+    printf("Assumed CPU freq = %.2f GHz, iters = %u\n\n", FREQ_GHZ, ITERS);
+
+    // 16 页足够覆盖所有偏移；按页对齐方便构造跨页访问
+    const size_t BUF_SIZE = 16 * PAGE;
+    uint8_t *buf = aligned_alloc(PAGE, BUF_SIZE);
+    if (!buf) {
+        fprintf(stderr, "aligned_alloc failed\n");
+        return 1;
+    }
+    memset(buf, 0, BUF_SIZE);
+
+    run_forwarding(buf);
+    run_split(buf);
+    run_4k_alias(buf);
+    run_disambiguation(buf);
+
+    free(buf);
+    return 0;
+}
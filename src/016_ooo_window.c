@@ -0,0 +1,246 @@
+// 016_ooo_window.c
+// 实验目的：探测乱序执行资源的容量（ROB / 物理寄存器堆 / load buffer / store buffer）
+// 方法：两条互相独立的 pointer-chasing 链各发起一次 DRAM miss，中间隔 N 条填充指令：
+//     a = ringA[a];  <N 条 filler>;  b = ringB[b];  <N 条 filler>
+//   只要两次 miss 加上中间的 filler 能同时放进被测结构，两次 miss 就能重叠，
+//   每轮约 1 个 miss 延迟；N 超过容量后两次 miss 被串行化，每轮升到约 2 个 miss 延迟
+//   filler 类型决定被占满的是哪一种资源：
+//     nop   -> ROB            int add -> 整数物理寄存器 (+ROB)
+//     load  -> load buffer    store   -> store buffer      fp add -> 浮点/向量寄存器
+// 与 03_retire_throughput.c 相同，用假定主频把时间换算成周期
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "harness.h"
+
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+#define REPEAT     5
+#define FREQ_GHZ   3.2
+#define RING_BYTES (128ull * 1024ull * 1024ull)   // 每条链 128 MiB，远大于 LLC
+#define LINE_WORDS 8                              // 每个节点独占一条 64B cache line
+#define ITERS      100000
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+// 以 cache line 为单位构造随机环：ring[line * 8] 存放下一个节点的下标
+static uint64_t *build_line_ring(size_t bytes) {
+    size_t lines = bytes / 64;
+    uint64_t *ring = aligned_alloc(64, bytes);
+    uint32_t *order = malloc(lines * sizeof(uint32_t));
+    if (!ring || !order) {
+        fprintf(stderr, "allocation failed in build_line_ring\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < lines; i++) order[i] = (uint32_t)i;
+    // Fisher–Yates（rand() 只有 31 位，拼两次保证覆盖所有行）
+    for (size_t i = lines - 1; i > 0; i--) {
+        size_t r = ((size_t)rand() << 16) ^ (size_t)rand();
+        size_t j = r % (i + 1);
+        uint32_t t = order[i]; order[i] = order[j]; order[j] = t;
+    }
+    for (size_t i = 0; i < lines; i++)
+        ring[(size_t)order[i] * LINE_WORDS] = (uint64_t)order[(i + 1) % lines] * LINE_WORDS;
+
+    free(order);
+    return ring;
+}
+
+/*
+   filler 指令：每组 4 条，写 4 个不同寄存器，组与组之间只有很短的依赖链
+   .rept 由汇编器展开，N 为编译期常量
+*/
+#define STR_(x) #x
+#define STR(x)  STR_(x)
+
+#if defined(__x86_64__)
+  #define FILL_NOP   "nop\n\tnop\n\tnop\n\tnop\n\t"
+  #define FILL_ADD   "add $1, %%r8\n\tadd $1, %%r9\n\tadd $1, %%r10\n\tadd $1, %%r11\n\t"
+  #define FILL_LOAD  "mov (%[s]), %%r8\n\tmov 8(%[s]), %%r9\n\tmov 16(%[s]), %%r10\n\tmov 24(%[s]), %%r11\n\t"
+  #define FILL_STORE "mov %%r8, 32(%[s])\n\tmov %%r9, 40(%[s])\n\tmov %%r10, 48(%[s])\n\tmov %%r11, 56(%[s])\n\t"
+  // AVX 三操作数形式，目的寄存器不依赖自身，filler 之间完全独立
+  // 源操作数 %[fx] / %[fy] 由 C 初始化为正常浮点数，避免读到未定义值（可能是 denormal）
+  #define FILL_FP    "vaddps %[fx], %[fy], %%xmm8\n\tvaddps %[fx], %[fy], %%xmm11\n\t" \
+                     "vaddps %[fx], %[fy], %%xmm12\n\tvaddps %[fx], %[fy], %%xmm13\n\t"
+  #define FILL_FP_CONSTRAINT "x"
+  #define FILL_CLOBBERS "r8", "r9", "r10", "r11", "xmm8", "xmm11", "xmm12", "xmm13", "memory"
+#elif defined(__aarch64__)
+  #define FILL_NOP   "nop\n\tnop\n\tnop\n\tnop\n\t"
+  #define FILL_ADD   "add x9, x9, #1\n\tadd x10, x10, #1\n\tadd x11, x11, #1\n\tadd x12, x12, #1\n\t"
+  #define FILL_LOAD  "ldr x9, [%[s]]\n\tldr x10, [%[s], #8]\n\tldr x11, [%[s], #16]\n\tldr x12, [%[s], #24]\n\t"
+  #define FILL_STORE "str x9, [%[s], #32]\n\tstr x10, [%[s], #40]\n\tstr x11, [%[s], #48]\n\tstr x12, [%[s], #56]\n\t"
+  #define FILL_FP    "fadd d16, %d[fx], %d[fy]\n\tfadd d19, %d[fx], %d[fy]\n\t" \
+                     "fadd d20, %d[fx], %d[fy]\n\tfadd d21, %d[fx], %d[fy]\n\t"
+  #define FILL_FP_CONSTRAINT "w"
+  #define FILL_CLOBBERS "x9", "x10", "x11", "x12", "v16", "v19", "v20", "v21", "memory"
+#endif
+
+#define FILLER_COUNTS(X, kind) \
+    X(kind, 0)   X(kind, 16)  X(kind, 32)  X(kind, 48)  X(kind, 64)  X(kind, 80)  \
+    X(kind, 96)  X(kind, 112) X(kind, 128) X(kind, 144) X(kind, 160) X(kind, 176) \
+    X(kind, 192) X(kind, 208) X(kind, 224) X(kind, 240) X(kind, 256) X(kind, 288) \
+    X(kind, 320) X(kind, 352) X(kind, 384) X(kind, 416) X(kind, 448) X(kind, 480) \
+    X(kind, 512) X(kind, 576) X(kind, 640)
+
+#if defined(FILL_NOP)
+
+#define DEF_PROBE(kind, N)                                                       \
+    static NOINLINE uint64_t probe_##kind##_##N(const uint64_t *ra, const uint64_t *rb, \
+                                                uint64_t *scratch, size_t iters) {     \
+        uint64_t a = 0, b = 0;                                                   \
+        double fx = 1.0, fy = 2.0;                                               \
+        for (size_t i = 0; i < iters; i++) {                                     \
+            a = ra[a];                                                           \
+            __asm__ volatile(".rept " STR(N) "/4\n\t" FILL_##kind ".endr"        \
+                             : : [s] "r"(scratch), [fx] FILL_FP_CONSTRAINT(fx),   \
+                                 [fy] FILL_FP_CONSTRAINT(fy) : FILL_CLOBBERS);   \
+            b = rb[b];                                                           \
+            __asm__ volatile(".rept " STR(N) "/4\n\t" FILL_##kind ".endr"        \
+                             : : [s] "r"(scratch), [fx] FILL_FP_CONSTRAINT(fx),   \
+                                 [fy] FILL_FP_CONSTRAINT(fy) : FILL_CLOBBERS);   \
+        }                                                                        \
+        return a + b;                                                            \
+    }
+
+FILLER_COUNTS(DEF_PROBE, NOP)
+FILLER_COUNTS(DEF_PROBE, ADD)
+FILLER_COUNTS(DEF_PROBE, LOAD)
+FILLER_COUNTS(DEF_PROBE, STORE)
+FILLER_COUNTS(DEF_PROBE, FP)
+
+typedef uint64_t (*probe_fn)(const uint64_t *, const uint64_t *, uint64_t *, size_t);
+
+typedef struct {
+    int      n;
+    probe_fn fn;
+} probe_entry;
+
+#define PROBE_ENTRY(kind, N) { N, probe_##kind##_##N },
+
+static const probe_entry probes_nop[]   = { FILLER_COUNTS(PROBE_ENTRY, NOP) };
+static const probe_entry probes_add[]   = { FILLER_COUNTS(PROBE_ENTRY, ADD) };
+static const probe_entry probes_load[]  = { FILLER_COUNTS(PROBE_ENTRY, LOAD) };
+static const probe_entry probes_store[] = { FILLER_COUNTS(PROBE_ENTRY, STORE) };
+static const probe_entry probes_fp[]    = { FILLER_COUNTS(PROBE_ENTRY, FP) };
+
+#define NUM_COUNTS (sizeof(probes_nop) / sizeof(probes_nop[0]))
+
+static volatile uint64_t sink;
+
+static double cycles_per_iter(probe_fn fn, const uint64_t *ra, const uint64_t *rb, uint64_t *scratch) {
+    double samples[REPEAT];
+    uint64_t t_oh = timer_overhead_ns();
+
+    for (int r = 0; r < REPEAT; r++) {
+        warmup_busy_loop(20000);
+
+        uint64_t t0 = now_ns();
+        sink = fn(ra, rb, scratch, ITERS);
+        uint64_t t1 = now_ns();
+
+        double ns = (double)(int64_t)(t1 - t0 - t_oh);
+        if (ns < 0) ns = 0;
+        samples[r] = ns * FREQ_GHZ / (double)ITERS;
+    }
+    return median(samples, REPEAT);
+}
+
+int main(void) {
+    printf("[16] Out-of-Order Window Size Probe (two overlapping DRAM misses)\n");
+    printf("Assumed CPU freq = %.2f GHz, ring = %.0f MiB x 2, iters = %d\n\n",
+           FREQ_GHZ, RING_BYTES / 1024.0 / 1024.0, ITERS);
+
+    uint64_t *ra = build_line_ring(RING_BYTES);
+    uint64_t *rb = build_line_ring(RING_BYTES);
+    uint64_t *scratch = aligned_alloc(64, 64);
+    for (int i = 0; i < 8; i++) scratch[i] = (uint64_t)i;
+
+    struct {
+        const char        *name;
+        const probe_entry *probes;
+        int                enabled;
+    } kinds[] = {
+        { "nop",   probes_nop,   1 },
+        { "int",   probes_add,   1 },
+        { "load",  probes_load,  1 },
+        { "store", probes_store, 1 },
+        { "fp",    probes_fp,    1 },
+    };
+    const int NK = (int)(sizeof(kinds) / sizeof(kinds[0]));
+#if defined(__x86_64__)
+    if (!__builtin_cpu_supports("avx")) {
+        kinds[NK - 1].enabled = 0;
+        printf("NOTE: AVX not available, fp filler skipped.\n\n");
+    }
+#endif
+
+    double table[NUM_COUNTS][8];
+
+    printf("%6s", "N");
+    for (int k = 0; k < NK; k++) printf("  %9s", kinds[k].name);
+    printf("\n-------------------------------------------------------------\n");
+
+    for (size_t c = 0; c < NUM_COUNTS; c++) {
+        printf("%6d", probes_nop[c].n);
+        for (int k = 0; k < NK; k++) {
+            if (!kinds[k].enabled) {
+                table[c][k] = 0;
+                printf("  %9s", "-");
+                continue;
+            }
+            table[c][k] = cycles_per_iter(kinds[k].probes[c].fn, ra, rb, scratch);
+            printf("  %9.1f", table[c][k]);
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    // 拐点：第一次超过 N=0 时 1.5 倍的位置，即两次 miss 不再重叠
+    printf("\nEstimated capacity (filler count where the two misses stop overlapping):\n");
+    for (int k = 0; k < NK; k++) {
+        if (!kinds[k].enabled) continue;
+        double base = table[0][k];
+        int knee = -1;
+        for (size_t c = 1; c < NUM_COUNTS; c++) {
+            if (table[c][k] > 1.5 * base) {
+                knee = kinds[k].probes[c].n;
+                break;
+            }
+        }
+        if (knee < 0) printf("  %-6s: > %d\n", kinds[k].name, probes_nop[NUM_COUNTS - 1].n);
+        else          printf("  %-6s: ~%d\n", kinds[k].name, knee);
+    }
+
+    free(ra);
+    free(rb);
+    free(scratch);
+    return 0;
+}
+
+#else
+
+int main(void) {
+    printf("[16] Out-of-Order Window Size Probe\n");
+    printf("Unsupported architecture (needs x86-64 or AArch64 filler encodings).\n");
+    return 0;
+}
+
+#endif
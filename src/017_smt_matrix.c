@@ -0,0 +1,298 @@
+// 017_smt_matrix.c
+// 实验目的：在真实的 SMT 兄弟线程上测量不同负载之间的干扰矩阵
+// 011_smt_sim.c 中两个线程不绑核，Linux 可能把它们放到不同物理核上；这里改为：
+//   1. 从 /sys/devices/system/cpu/cpu*/topology/thread_siblings_list 读取兄弟线程
+//   2. 把一对负载分别绑到 同一物理核的两个逻辑 CPU（SMT）和 两个不同物理核 上
+//   3. 7 种负载两两组合，每个线程报告相对单独运行时的减速比
+// 每个线程在固定时间窗口内反复执行小块工作，保证两个线程全程重叠
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "harness.h"
+
+#define WINDOW_MS    200                          // 每次测量的时间窗口
+#define L1_BYTES     (16 * 1024)                  // L1 负载的工作集
+#define DRAM_BYTES   (256ull * 1024 * 1024)       // 流式负载的工作集
+#define CHASE_BYTES  (64ull * 1024 * 1024)        // pointer chasing 的工作集
+#define BRANCH_LEN   65536
+
+enum { W_ALU, W_FP, W_SIMD, W_L1, W_DRAM, W_BRANCH, W_CHASE, NUM_WORKLOADS };
+
+static const char *workload_names[NUM_WORKLOADS] = {
+    "int-alu", "fp", "simd", "l1-load", "dram", "branchy", "chase"
+};
+
+// 每个线程槽位（0/1）各自持有一份数据，避免两个线程共享 cache line
+typedef struct {
+    uint64_t *l1;
+    uint64_t *dram;
+    size_t    dram_pos;
+    uint32_t *chase;
+    uint32_t  chase_idx;
+    uint8_t  *bits;
+    size_t    bits_pos;
+} workload_data;
+
+static workload_data slot_data[2];
+
+// -------- 负载：每次调用执行一小块工作（几十微秒） --------
+
+static uint64_t work_alu(workload_data *d) {
+    (void)d;
+    uint64_t a = 1, b = 2, c = 3, e = 4;
+    for (int i = 0; i < 20000; i++) {
+        a = a * 3 + 7; b ^= b << 1; c += c >> 3; e = e * 5 + 1;
+    }
+    return a + b + c + e;
+}
+
+static uint64_t work_fp(workload_data *d) {
+    (void)d;
+    double a0 = 1.0, a1 = 1.1, a2 = 1.2, a3 = 1.3, a4 = 1.4, a5 = 1.5, a6 = 1.6, a7 = 1.7;
+    const double m = 0.999999, k = 1e-7;
+    for (int i = 0; i < 10000; i++) {
+        a0 = a0 * m + k; a1 = a1 * m + k; a2 = a2 * m + k; a3 = a3 * m + k;
+        a4 = a4 * m + k; a5 = a5 * m + k; a6 = a6 * m + k; a7 = a7 * m + k;
+    }
+    return (uint64_t)(a0 + a1 + a2 + a3 + a4 + a5 + a6 + a7);
+}
+
+// GCC/Clang 向量扩展：x86 上编译为 SSE，ARM 上为 NEON
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+
+static uint64_t work_simd(workload_data *d) {
+    (void)d;
+    v4u32 a = {1, 2, 3, 4}, b = {5, 6, 7, 8}, c = {9, 10, 11, 12}, e = {13, 14, 15, 16};
+    const v4u32 m = {3, 5, 7, 9}, k = {1, 1, 1, 1};
+    for (int i = 0; i < 10000; i++) {
+        a = a * m + k; b = b * m + k; c = c * m + k; e = e * m + k;
+    }
+    v4u32 s = a + b + c + e;
+    return s[0] + s[1] + s[2] + s[3];
+}
+
+static uint64_t work_l1(workload_data *d) {
+    const uint64_t *p = d->l1;
+    const size_t n = L1_BYTES / sizeof(uint64_t);
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (int rep = 0; rep < 16; rep++) {
+        for (size_t i = 0; i < n; i += 4) {
+            s0 += p[i]; s1 += p[i + 1]; s2 += p[i + 2]; s3 += p[i + 3];
+        }
+        __asm__ volatile("" ::: "memory");
+    }
+    return s0 + s1 + s2 + s3;
+}
+
+static uint64_t work_dram(workload_data *d) {
+    // 每块读 256 KiB，位置在整个工作集上循环推进
+    const size_t chunk = 256 * 1024 / sizeof(uint64_t);
+    const size_t n = DRAM_BYTES / sizeof(uint64_t);
+    const uint64_t *p = d->dram + d->dram_pos;
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (size_t i = 0; i < chunk; i += 8) {
+        s0 += p[i]; s1 += p[i + 2]; s2 += p[i + 4]; s3 += p[i + 6];
+    }
+    d->dram_pos = (d->dram_pos + chunk) % n;
+    return s0 + s1 + s2 + s3;
+}
+
+static volatile uint64_t br_t, br_n;
+
+static uint64_t work_branch(workload_data *d) {
+    for (size_t i = 0; i < 8192; i++) {
+        if (d->bits[d->bits_pos + i]) br_t++;
+        else                          br_n++;
+    }
+    d->bits_pos = (d->bits_pos + 8192) % BRANCH_LEN;
+    return 0;
+}
+
+static uint64_t work_chase(workload_data *d) {
+    uint32_t idx = d->chase_idx;
+    for (int i = 0; i < 1000; i++) idx = d->chase[idx];
+    d->chase_idx = idx;
+    return idx;
+}
+
+typedef uint64_t (*work_fn)(workload_data *);
+static const work_fn workloads[NUM_WORKLOADS] = {
+    work_alu, work_fp, work_simd, work_l1, work_dram, work_branch, work_chase
+};
+
+// 与 09_dram_latency.c 相同的随机环
+static void build_random_ring(uint32_t *buf, size_t len) {
+    uint32_t *tmp = malloc(len * sizeof(uint32_t));
+    for (size_t i = 0; i < len; i++) tmp[i] = (uint32_t)i;
+    for (size_t i = len - 1; i > 0; i--) {
+        size_t j = (((size_t)rand() << 16) ^ (size_t)rand()) % (i + 1);
+        uint32_t t = tmp[i]; tmp[i] = tmp[j]; tmp[j] = t;
+    }
+    for (size_t i = 0; i < len - 1; i++) buf[tmp[i]] = tmp[i + 1];
+    buf[tmp[len - 1]] = tmp[0];
+    free(tmp);
+}
+
+static void init_slot(workload_data *d) {
+    d->l1 = aligned_alloc(64, L1_BYTES);
+    d->dram = aligned_alloc(64, DRAM_BYTES);
+    d->chase = aligned_alloc(64, CHASE_BYTES);
+    d->bits = malloc(BRANCH_LEN);
+    if (!d->l1 || !d->dram || !d->chase || !d->bits) {
+        fprintf(stderr, "allocation failed\n");
+        exit(1);
+    }
+    memset(d->l1, 1, L1_BYTES);
+    memset(d->dram, 1, DRAM_BYTES);
+    build_random_ring(d->chase, CHASE_BYTES / sizeof(uint32_t));
+    for (size_t i = 0; i < BRANCH_LEN; i++) d->bits[i] = (uint8_t)(rand() & 1);
+    d->dram_pos = 0;
+    d->chase_idx = 0;
+    d->bits_pos = 0;
+}
+
+// -------- 线程启动（沿用 011 的 thread_arg 结构，增加绑核与计数） --------
+
+typedef struct {
+    int            type;       // 负载类型
+    int            cpu;        // 绑定的逻辑 CPU
+    int            slot;       // 使用哪一份数据
+    volatile int  *start;
+    volatile int  *stop;
+    double         rate;       // 返回：每秒完成的工作块数
+    uint64_t       sink;
+} thread_arg;
+
+static void *run_worker(void *arg) {
+    thread_arg *a = (thread_arg *)arg;
+    pin_thread_to_cpu(a->cpu);
+    workload_data *d = &slot_data[a->slot];
+    work_fn fn = workloads[a->type];
+
+    while (!*a->start) { /* spin */ }
+
+    uint64_t chunks = 0, acc = 0;
+    uint64_t t0 = now_ns();
+    while (!*a->stop) {
+        acc += fn(d);
+        chunks++;
+    }
+    uint64_t t1 = now_ns();
+
+    a->sink = acc;
+    a->rate = (double)chunks * 1e9 / (double)(t1 - t0);
+    return NULL;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+// 同时启动 n 个线程（1 或 2 个），运行 WINDOW_MS 毫秒
+static void launch(thread_arg *args, int n) {
+    pthread_t th[2];
+    volatile int start = 0, stop = 0;
+
+    for (int i = 0; i < n; i++) {
+        args[i].start = &start;
+        args[i].stop = &stop;
+        pthread_create(&th[i], NULL, run_worker, &args[i]);
+    }
+    start = 1;
+    sleep_ms(WINDOW_MS);
+    stop = 1;
+    for (int i = 0; i < n; i++) pthread_join(th[i], NULL);
+}
+
+// 打印一种放置方式下的矩阵：第 r 行第 c 列 = 负载 r 与负载 c 同时运行时，r 的减速比
+static void run_matrix(const char *label, int cpu_a, int cpu_b, const double *solo) {
+    printf("=== %s (cpu %d + cpu %d) ===\n", label, cpu_a, cpu_b);
+    printf("slowdown of row workload when co-running with column workload (1.00 = no interference)\n");
+    printf("%-9s", "");
+    for (int c = 0; c < NUM_WORKLOADS; c++) printf(" %8s", workload_names[c]);
+    printf("\n");
+
+    for (int r = 0; r < NUM_WORKLOADS; r++) {
+        printf("%-9s", workload_names[r]);
+        for (int c = 0; c < NUM_WORKLOADS; c++) {
+            thread_arg args[2] = {
+                { .type = r, .cpu = cpu_a, .slot = 0 },
+                { .type = c, .cpu = cpu_b, .slot = 1 },
+            };
+            launch(args, 2);
+            printf(" %8.2f", solo[r] / args[0].rate);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+int main(void) {
+    printf("[17] SMT Contention Matrix (pinned sibling hyperthreads)\n");
+
+    int ncpu = num_online_cpus();
+    int siblings[8];
+
+    // 找第一个拥有 SMT 兄弟的逻辑 CPU
+    int smt_a = -1, smt_b = -1;
+    for (int cpu = 0; cpu < ncpu && smt_a < 0; cpu++) {
+        int n = cpu_smt_siblings(cpu, siblings, 8);
+        if (n >= 2) {
+            smt_a = siblings[0];
+            smt_b = siblings[1];
+        }
+    }
+
+    // 找一个与 cpu0 不在同一物理核上的 CPU
+    int sep_a = 0, sep_b = -1;
+    int n0 = cpu_smt_siblings(0, siblings, 8);
+    for (int cpu = 1; cpu < ncpu && sep_b < 0; cpu++) {
+        int same = 0;
+        for (int i = 0; i < n0; i++) if (siblings[i] == cpu) same = 1;
+        if (!same) sep_b = cpu;
+    }
+
+    if (pin_thread_to_cpu(0) != 0)
+        printf("NOTE: thread pinning unavailable on this platform; placements are only hints.\n");
+    if (smt_a < 0)
+        printf("NOTE: no SMT siblings found (SMT off or unsupported); sibling matrix skipped.\n");
+    if (sep_b < 0)
+        printf("NOTE: only one physical core online; separate-core matrix skipped.\n");
+    printf("Online CPUs: %d, window = %d ms per cell\n\n", ncpu, WINDOW_MS);
+
+    srand(1);
+    init_slot(&slot_data[0]);
+    init_slot(&slot_data[1]);
+
+    // 单独运行的基准速率（绑在矩阵使用的第一个 CPU 上）
+    double solo[NUM_WORKLOADS];
+    int solo_cpu = (smt_a >= 0) ? smt_a : sep_a;
+    printf("Solo rate (chunks/s) on cpu %d:\n", solo_cpu);
+    for (int w = 0; w < NUM_WORKLOADS; w++) {
+        thread_arg arg = { .type = w, .cpu = solo_cpu, .slot = 0 };
+        launch(&arg, 1);
+        solo[w] = arg.rate;
+        printf("  %-9s %12.0f\n", workload_names[w], solo[w]);
+    }
+    printf("\n");
+
+    if (smt_a >= 0)
+        run_matrix("Same physical core (SMT siblings)", smt_a, smt_b, solo);
+    if (sep_b >= 0)
+        run_matrix("Separate physical cores", sep_a, sep_b, solo);
+
+    for (int s = 0; s < 2; s++) {
+        free(slot_data[s].l1);
+        free(slot_data[s].dram);
+        free(slot_data[s].chase);
+        free(slot_data[s].bits);
+    }
+    return 0;
+}
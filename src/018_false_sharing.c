@@ -0,0 +1,142 @@
+// 018_false_sharing.c
+// 实验目的：测量伪共享 (false sharing) 对多线程计数器的影响，确定每核统计结构需要多少填充
+// 方法：1..N 个绑核线程各自递增 “自己的” 计数器，计数器的摆放方式为：
+//   packed    ：相邻 8B，每条 64B cache line 放 8 个（超过 8 个线程时分布在多条 line 上，每条仍有 8 个线程争用）
+//   pad64     ：每个计数器独占 64B
+//   pad128    ：每个计数器独占 128B（避开相邻行预取 / 128B 组粒度）
+//   page      ：每个计数器独占一个 4 KiB 页
+// 线程框架沿用 011_smt_sim.c / 017_smt_matrix.c：同时启动，固定时间窗口，报告每线程和总吞吐
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "harness.h"
+
+#define WINDOW_MS   200
+#define MAX_THREADS 256
+#define UNROLL      64      // 每次检查 stop 之前的递增次数
+
+typedef struct {
+    const char *name;
+    size_t      stride;     // 相邻计数器之间的字节数
+} layout_cfg;
+
+static const layout_cfg layouts[] = {
+    { "packed", 8    },
+    { "pad64",  64   },
+    { "pad128", 128  },
+    { "page",   4096 },
+};
+
+typedef struct {
+    int                 cpu;
+    volatile uint64_t  *counter;
+    volatile int       *start;
+    volatile int       *stop;
+    double              rate;       // 返回：每秒递增次数
+} thread_arg;
+
+static void *run_counter(void *arg) {
+    thread_arg *a = (thread_arg *)arg;
+    pin_thread_to_cpu(a->cpu);
+    volatile uint64_t *c = a->counter;
+
+    while (!*a->start) { /* spin */ }
+
+    uint64_t ops = 0;
+    uint64_t t0 = now_ns();
+    while (!*a->stop) {
+        for (int u = 0; u < UNROLL; u++) (*c)++;
+        ops += UNROLL;
+    }
+    uint64_t t1 = now_ns();
+
+    a->rate = (double)ops * 1e9 / (double)(t1 - t0);
+    return NULL;
+}
+
+// 线程数序列：1, 2, 4, ...，最后一定包含 max
+static int thread_counts(int max, int *out) {
+    int n = 0;
+    for (int t = 1; t < max; t *= 2) out[n++] = t;
+    out[n++] = max;
+    return n;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+// 启动 n 个线程，计数器位于 base + i * stride
+static void launch(thread_arg *args, int n, uint8_t *base, size_t stride, int ncpu) {
+    pthread_t th[MAX_THREADS];
+    volatile int start = 0, stop = 0;
+
+    for (int i = 0; i < n; i++) {
+        args[i].cpu = i % ncpu;
+        args[i].counter = (volatile uint64_t *)(base + (size_t)i * stride);
+        args[i].start = &start;
+        args[i].stop = &stop;
+        *args[i].counter = 0;
+        pthread_create(&th[i], NULL, run_counter, &args[i]);
+    }
+    start = 1;
+    sleep_ms(WINDOW_MS);
+    stop = 1;
+    for (int i = 0; i < n; i++) pthread_join(th[i], NULL);
+}
+
+int main(void) {
+    int ncpu = num_online_cpus();
+    int max_threads = ncpu < MAX_THREADS ? ncpu : MAX_THREADS;
+
+    printf("[18] False Sharing / Cache-Line Contention Scaling\n");
+    printf("Online CPUs: %d, thread i pinned to cpu i, window = %d ms\n", ncpu, WINDOW_MS);
+    printf("packed = adjacent 8 B counters, 8 per 64 B line (beyond 8 threads they span several lines)\n");
+    if (pin_thread_to_cpu(0) != 0)
+        printf("NOTE: thread pinning unavailable on this platform; threads float.\n");
+    printf("\n");
+
+    uint8_t *base = aligned_alloc(4096, (size_t)MAX_THREADS * 4096);
+    if (!base) {
+        fprintf(stderr, "aligned_alloc failed\n");
+        return 1;
+    }
+    memset(base, 0, (size_t)MAX_THREADS * 4096);
+
+    thread_arg *args = calloc(MAX_THREADS, sizeof(thread_arg));
+
+    printf("%-8s %7s %14s %14s %14s %14s\n",
+           "Layout", "Threads", "Total Mops/s", "Min/thread", "Avg/thread", "Max/thread");
+    printf("-----------------------------------------------------------------------------\n");
+
+    int counts[32];
+    int num_counts = thread_counts(max_threads, counts);
+
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        for (int c = 0; c < num_counts; c++) {
+            int n = counts[c];
+            launch(args, n, base, layouts[l].stride, ncpu);
+
+            double total = 0, mn = 1e30, mx = 0;
+            for (int i = 0; i < n; i++) {
+                total += args[i].rate;
+                if (args[i].rate < mn) mn = args[i].rate;
+                if (args[i].rate > mx) mx = args[i].rate;
+            }
+            printf("%-8s %7d %14.1f %14.1f %14.1f %14.1f\n",
+                   layouts[l].name, n, total / 1e6, mn / 1e6, total / n / 1e6, mx / 1e6);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+
+    free(args);
+    free(base);
+    return 0;
+}
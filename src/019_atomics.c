@@ -0,0 +1,284 @@
+// 019_atomics.c
+// 实验目的：测量原子操作在无竞争和有竞争情况下的开销
+// 方法：
+//   A) 单线程（无竞争）：fetch_add / compare_exchange（成功 / 失败路径） / exchange / load / store（不同内存序）/ fence，
+//      每个操作循环执行，得到每次操作的 ns 与周期
+//   B) 多线程竞争：2..N 个绑核线程对同一个地址执行同一种操作，
+//      报告总吞吐、每线程每次操作耗时，以及 CAS 失败率
+// 使用 C11 <stdatomic.h>，线程框架同 017/018（固定时间窗口）
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "harness.h"
+
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+#define REPEAT      11
+#define FREQ_GHZ    3.2
+#define ITERS       (2u << 20)
+#define WINDOW_MS   200
+#define MAX_THREADS 256
+#define UNROLL      16
+
+// 被测原子变量独占一条 cache line
+static _Alignas(128) _Atomic uint64_t target;
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+/*
+   A) 无竞争：每个内核执行 n 次操作
+*/
+typedef uint64_t (*atomic_kernel)(size_t n);
+
+#define DEF_KERNEL(name, BODY)                          \
+    static NOINLINE uint64_t k_##name(size_t n) {       \
+        uint64_t acc = 0;                               \
+        for (size_t i = 0; i < n; i++) { BODY; }        \
+        return acc;                                     \
+    }
+
+DEF_KERNEL(plain_add,     acc += i; __asm__ volatile("" : "+r"(acc)))
+DEF_KERNEL(fadd_relaxed,  acc += atomic_fetch_add_explicit(&target, 1, memory_order_relaxed))
+DEF_KERNEL(fadd_seq,      acc += atomic_fetch_add_explicit(&target, 1, memory_order_seq_cst))
+DEF_KERNEL(xchg_seq,      acc += atomic_exchange_explicit(&target, i, memory_order_seq_cst))
+
+// CAS 成功路径：期望值跨迭代携带，每次都把 e 换成 e + 1
+static NOINLINE uint64_t k_cas_seq(size_t n) {
+    uint64_t acc = 0, e = atomic_load_explicit(&target, memory_order_relaxed);
+    for (size_t i = 0; i < n; i++) {
+        int ok = atomic_compare_exchange_strong_explicit(&target, &e, e + 1,
+                                                         memory_order_seq_cst, memory_order_seq_cst);
+        acc += (uint64_t)ok;
+        if (ok) e++;                    // 失败时 e 已被更新为当前值
+    }
+    return acc;
+}
+
+// CAS 失败路径：期望值总比当前值大 1，比较必然失败
+static NOINLINE uint64_t k_cas_fail(size_t n) {
+    uint64_t acc = 0, cur = atomic_load_explicit(&target, memory_order_relaxed);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t e = cur + 1;
+        acc += (uint64_t)atomic_compare_exchange_strong_explicit(&target, &e, e + 1,
+                                                                 memory_order_seq_cst, memory_order_seq_cst);
+        cur = e;
+    }
+    return acc;
+}
+
+DEF_KERNEL(load_relaxed,  acc += atomic_load_explicit(&target, memory_order_relaxed))
+DEF_KERNEL(load_acquire,  acc += atomic_load_explicit(&target, memory_order_acquire))
+DEF_KERNEL(load_seq,      acc += atomic_load_explicit(&target, memory_order_seq_cst))
+DEF_KERNEL(store_relaxed, atomic_store_explicit(&target, i, memory_order_relaxed))
+DEF_KERNEL(store_release, atomic_store_explicit(&target, i, memory_order_release))
+DEF_KERNEL(store_seq,     atomic_store_explicit(&target, i, memory_order_seq_cst))
+DEF_KERNEL(fence_acquire, atomic_thread_fence(memory_order_acquire); acc += i)
+DEF_KERNEL(fence_release, atomic_thread_fence(memory_order_release); acc += i)
+DEF_KERNEL(fence_seq,     atomic_thread_fence(memory_order_seq_cst); acc += i)
+
+static volatile uint64_t sink;
+
+static double ns_per_op(atomic_kernel fn) {
+    double samples[REPEAT];
+    uint64_t t_oh = timer_overhead_ns();
+
+    for (int r = 0; r < REPEAT; r++) {
+        warmup_busy_loop(20000);
+
+        uint64_t t0 = now_ns();
+        sink = fn(ITERS);
+        uint64_t t1 = now_ns();
+
+        double ns = (double)(int64_t)(t1 - t0 - t_oh);
+        if (ns < 0) ns = 0;
+        samples[r] = ns / (double)ITERS;
+    }
+    return median(samples, REPEAT);
+}
+
+static void run_uncontended(void) {
+    static const struct { const char *label; atomic_kernel fn; } ops[] = {
+        { "fetch_add relaxed",   k_fadd_relaxed },
+        { "fetch_add seq_cst",   k_fadd_seq },
+        { "exchange seq_cst",    k_xchg_seq },
+        { "CAS strong seq_cst",  k_cas_seq },
+        { "CAS strong (fails)",  k_cas_fail },
+        { "load relaxed",        k_load_relaxed },
+        { "load acquire",        k_load_acquire },
+        { "load seq_cst",        k_load_seq },
+        { "store relaxed",       k_store_relaxed },
+        { "store release",       k_store_release },
+        { "store seq_cst",       k_store_seq },
+        { "fence acquire",       k_fence_acquire },
+        { "fence release",       k_fence_release },
+        { "fence seq_cst",       k_fence_seq },
+    };
+
+    double base = ns_per_op(k_plain_add);
+
+    printf("A) Uncontended (single thread), loop overhead subtracted\n");
+    printf("  %-22s %10s %10s\n", "Operation", "ns/op", "cycles/op");
+    printf("  ------------------------------------------\n");
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        double ns = ns_per_op(ops[i].fn) - base;
+        if (ns < 0) ns = 0;
+        printf("  %-22s %10.3f %10.2f\n", ops[i].label, ns, ns * FREQ_GHZ);
+    }
+    printf("\n");
+}
+
+/*
+   B) 竞争：所有线程操作同一个 target
+*/
+enum { OP_FADD, OP_CAS, OP_XCHG, OP_STORE, OP_LOAD, NUM_OPS };
+static const char *op_names[NUM_OPS] = {
+    "fetch_add", "CAS incr", "exchange", "store seq", "load acq"
+};
+
+typedef struct {
+    int           op;
+    int           cpu;
+    volatile int *start;
+    volatile int *stop;
+    uint64_t      ops;          // 成功完成的操作数
+    uint64_t      cas_fail;     // CAS 失败次数
+    double        seconds;
+} thread_arg;
+
+static void *run_atomic(void *arg) {
+    thread_arg *a = (thread_arg *)arg;
+    pin_thread_to_cpu(a->cpu);
+
+    while (!*a->start) { /* spin */ }
+
+    uint64_t ops = 0, fail = 0, acc = 0;
+    uint64_t t0 = now_ns();
+    while (!*a->stop) {
+        for (int u = 0; u < UNROLL; u++) {
+            switch (a->op) {
+            case OP_FADD:
+                atomic_fetch_add_explicit(&target, 1, memory_order_seq_cst);
+                break;
+            case OP_CAS: {
+                uint64_t e = atomic_load_explicit(&target, memory_order_relaxed);
+                while (!atomic_compare_exchange_strong_explicit(&target, &e, e + 1,
+                            memory_order_seq_cst, memory_order_relaxed))
+                    fail++;
+                break;
+            }
+            case OP_XCHG:
+                acc += atomic_exchange_explicit(&target, ops, memory_order_seq_cst);
+                break;
+            case OP_STORE:
+                atomic_store_explicit(&target, ops, memory_order_seq_cst);
+                break;
+            case OP_LOAD:
+                acc += atomic_load_explicit(&target, memory_order_acquire);
+                break;
+            }
+        }
+        ops += UNROLL;
+    }
+    uint64_t t1 = now_ns();
+
+    sink = acc;
+    a->ops = ops;
+    a->cas_fail = fail;
+    a->seconds = (double)(t1 - t0) / 1e9;
+    return NULL;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static int thread_counts(int max, int *out) {
+    int n = 0;
+    for (int t = 1; t < max; t *= 2) out[n++] = t;
+    out[n++] = max;
+    return n;
+}
+
+static void run_contended(int ncpu) {
+    int max_threads = ncpu < MAX_THREADS ? ncpu : MAX_THREADS;
+    int counts[32];
+    int num_counts = thread_counts(max_threads, counts);
+    thread_arg *args = calloc(MAX_THREADS, sizeof(thread_arg));
+    pthread_t *th = calloc(MAX_THREADS, sizeof(pthread_t));
+
+    printf("B) Contended: all threads on one cache line (thread i pinned to cpu i)\n");
+    printf("  %-10s %7s %14s %14s %12s\n", "Operation", "Threads", "Total Mops/s", "ns/op/thread", "CAS fail %");
+    printf("  ---------------------------------------------------------------\n");
+
+    for (int op = 0; op < NUM_OPS; op++) {
+        for (int c = 0; c < num_counts; c++) {
+            int n = counts[c];
+            volatile int start = 0, stop = 0;
+            atomic_store(&target, 0);
+
+            for (int i = 0; i < n; i++) {
+                args[i] = (thread_arg){ .op = op, .cpu = i % ncpu, .start = &start, .stop = &stop };
+                pthread_create(&th[i], NULL, run_atomic, &args[i]);
+            }
+            start = 1;
+            sleep_ms(WINDOW_MS);
+            stop = 1;
+            for (int i = 0; i < n; i++) pthread_join(th[i], NULL);
+
+            double total_rate = 0, lat = 0;
+            uint64_t total_ops = 0, total_fail = 0;
+            for (int i = 0; i < n; i++) {
+                total_rate += (double)args[i].ops / args[i].seconds;
+                lat += args[i].seconds * 1e9 / (double)args[i].ops;
+                total_ops += args[i].ops;
+                total_fail += args[i].cas_fail;
+            }
+            printf("  %-10s %7d %14.1f %14.2f ", op_names[op], n, total_rate / 1e6, lat / n);
+            if (op == OP_CAS)
+                printf("%11.1f%%\n", 100.0 * (double)total_fail / (double)(total_ops + total_fail));
+            else
+                printf("%12s\n", "-");
+            fflush(stdout);
+        }
+    }
+    printf("\n");
+
+    free(args);
+    free(th);
+}
+
+int main(void) {
+    int ncpu = num_online_cpus();
+
+    printf("[19] Atomic Operation Latency & Contention Test\n");
+    printf("Assumed CPU freq = %.2f GHz, online CPUs = %d\n", FREQ_GHZ, ncpu);
+    if (pin_thread_to_cpu(0) != 0)
+        printf("NOTE: thread pinning unavailable on this platform; threads float.\n");
+    printf("\n");
+
+    run_uncontended();
+    run_contended(ncpu);
+    return 0;
+}
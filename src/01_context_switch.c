@@ -1,5 +1,9 @@
 // 01_context_switch.c
-// 两部分：A) 系统调用往返开销  B) 线程 ping-pong 切换开销
+// 三部分：A) 系统调用往返开销  B) 线程 ping-pong 切换开销
+//         C) 单次操作延迟分布：系统调用 / 上下文切换 / futex 唤醒 / DRAM miss 逐次打时间戳，
+//            写入 harness 的对数分桶直方图，报告 p50 / p90 / p99 / p99.9 / max
+//         更多系统调用（vDSO、I/O、futex、epoll、io_uring）的开销目录见 022_syscalls.c
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -8,9 +12,41 @@
 #include <pthread.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include "harness.h"
 #include <sys/syscall.h>   //
-#include <dispatch/dispatch.h>   // 
+
+#if defined(__linux__)
+  #include <stdatomic.h>
+  #include <linux/futex.h>
+#endif
+
+// -------- 信号量：macOS 用 GCD，其他平台用 POSIX 信号量 --------
+#if defined(__APPLE__)
+  #include <dispatch/dispatch.h>   //
+  typedef dispatch_semaphore_t sema_t;
+  static void sema_init(sema_t* s){ *s = dispatch_semaphore_create(0); }
+  static void sema_destroy(sema_t* s){ dispatch_release(*s); }
+  static void sema_signal(sema_t* s){ dispatch_semaphore_signal(*s); }
+  // 带 1 秒超时，成功返回 0
+  static int sema_wait_1s(sema_t* s){
+      return dispatch_semaphore_wait(*s, dispatch_time(DISPATCH_TIME_NOW, 1LL*1000*1000*1000)) != 0;
+  }
+#else
+  #include <semaphore.h>
+  typedef sem_t sema_t;
+  static void sema_init(sema_t* s){ sem_init(s, 0, 0); }
+  static void sema_destroy(sema_t* s){ sem_destroy(s); }
+  static void sema_signal(sema_t* s){ sem_post(s); }
+  static int sema_wait_1s(sema_t* s){
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_sec += 1;
+      int rc;
+      while ((rc = sem_timedwait(s, &ts)) != 0 && errno == EINTR) { }
+      return rc != 0;
+  }
+#endif
 
 // -------- 通用工具：double 的中位数 --------
 static double dmedian(double* a, size_t n){
@@ -62,10 +98,10 @@ static double syscall_roundtrip_ns(size_t iters){
     return floor(med*10.0 + 0.5)/10.0; // 保留 1 位小数
 }
 
-// -------- B) 线程 ping-pong（GCD 信号量 + 超时保护） --------
+// -------- B) 线程 ping-pong（信号量 + 超时保护） --------
 typedef struct {
-    dispatch_semaphore_t sem_main;    // worker -> main
-    dispatch_semaphore_t sem_worker;  // main   -> worker
+    sema_t sem_main;                  // worker -> main
+    sema_t sem_worker;                // main   -> worker
     size_t rounds;                    // 往返次数
     volatile int start;               // 同步信号（主线程发出后 worker 才启动）
     int warmup;                       // 预热轮数（让调度稳定）
@@ -80,14 +116,13 @@ static void* worker_thread(void* arg){
     size_t total = (size_t)p->warmup + p->rounds;  //总轮数 = 预热 + 正式
     for (size_t r=0; r<total; ++r) {
         
-        if (dispatch_semaphore_wait(p->sem_worker,
-            dispatch_time(DISPATCH_TIME_NOW, 1LL*1000*1000*1000)) != 0) {
+        if (sema_wait_1s(&p->sem_worker)) {
             // 等待 main 发“球”（带 1 秒超时保护，避免卡死）
             fprintf(stderr, "[worker] timeout waiting sem_worker at r=%zu\n", r);
             return NULL;
         }
         // 回球 -> 通知主线程 sem_main
-        dispatch_semaphore_signal(p->sem_main);
+        sema_signal(&p->sem_main);
     }
     return NULL;
 }
@@ -105,8 +140,8 @@ static double thread_switch_ns(size_t rounds){
         ctx.rounds = rounds;
         ctx.start  = 0;
         
-        ctx.sem_main   = dispatch_semaphore_create(0);
-        ctx.sem_worker = dispatch_semaphore_create(0);
+        sema_init(&ctx.sem_main);
+        sema_init(&ctx.sem_worker);
 
         // 创建子线程
         pthread_t th;
@@ -121,8 +156,8 @@ static double thread_switch_ns(size_t rounds){
 
         // 预热（不计时）：先发 200 个球并接回
         for (int i=0; i<200; ++i) {
-            dispatch_semaphore_signal(ctx.sem_worker); // main -> worker
-            if (dispatch_semaphore_wait(ctx.sem_main, dispatch_time(DISPATCH_TIME_NOW, 1LL*1000*1000*1000)) != 0) {
+            sema_signal(&ctx.sem_worker); // main -> worker
+            if (sema_wait_1s(&ctx.sem_main)) {
                 fprintf(stderr, "[main] warmup timeout at i=%d\n", i);
                 pthread_join(th, NULL);
                 samples[r] = NAN;
@@ -133,8 +168,8 @@ static double thread_switch_ns(size_t rounds){
         // 正式计时
         uint64_t t0 = now_ns();
         for (size_t i=0; i<rounds; ++i) {
-            dispatch_semaphore_signal(ctx.sem_worker); // main -> worker
-            if (dispatch_semaphore_wait(ctx.sem_main, dispatch_time(DISPATCH_TIME_NOW, 1LL*1000*1000*1000)) != 0) {
+            sema_signal(&ctx.sem_worker); // main -> worker
+            if (sema_wait_1s(&ctx.sem_main)) {
                 fprintf(stderr, "[main] timed run timeout at i=%zu\n", i);
                 pthread_join(th, NULL);
                 samples[r] = NAN;
@@ -154,7 +189,8 @@ static double thread_switch_ns(size_t rounds){
         }
 
     NEXT_ROUND:
-        ; // label 后空语句
+        sema_destroy(&ctx.sem_main);
+        sema_destroy(&ctx.sem_worker);
     }
 
     // 求中位数
@@ -169,6 +205,147 @@ static double thread_switch_ns(size_t rounds){
     return floor(med*10.0 + 0.5)/10.0; // 保留 1 位小数
 }
 
+// -------- C) 单次操作延迟分布：逐次打时间戳，写入对数直方图 --------
+// 整段循环时间除以次数只能得到平均值，看不到尾部；这里每次操作单独计时（扣除读表开销）
+
+static uint64_t net_ns(uint64_t t0, uint64_t t1, uint64_t tovh){
+    uint64_t d = t1 - t0;
+    return d > tovh ? d - tovh : 0;
+}
+
+// 单次 getpid 系统调用
+static void hist_syscall(latency_hist* h, size_t n){
+    const uint64_t tovh = timer_overhead_ns();
+    hist_reset(h);
+    for(size_t i=0;i<n;++i){
+        uint64_t t0 = now_ns();
+        (void)syscall(SYS_getpid);
+        uint64_t t1 = now_ns();
+        hist_record(h, net_ns(t0, t1, tovh));
+    }
+}
+
+// 信号量 ping-pong：每次往返单独计时，一次切换 = 往返 / 2
+static void hist_thread_switch(latency_hist* h, size_t rounds){
+    const uint64_t tovh = timer_overhead_ns();
+    const int warmup = 200;
+    hist_reset(h);
+
+    pingpong_ctx ctx;
+    ctx.rounds = rounds;
+    ctx.start  = 0;
+    ctx.warmup = warmup;
+    sema_init(&ctx.sem_main);
+    sema_init(&ctx.sem_worker);
+
+    pthread_t th;
+    if (pthread_create(&th, NULL, worker_thread, &ctx) != 0){ fprintf(stderr,"pthread_create failed\n"); exit(1); }
+    ctx.start = 1;
+
+    for (size_t i=0; i<(size_t)warmup + rounds; ++i) {
+        uint64_t t0 = now_ns();
+        sema_signal(&ctx.sem_worker);
+        if (sema_wait_1s(&ctx.sem_main)) {
+            fprintf(stderr, "[main] histogram run timeout at i=%zu\n", i);
+            break;
+        }
+        uint64_t t1 = now_ns();
+        if (i >= (size_t)warmup) hist_record(h, net_ns(t0, t1, tovh) / 2);
+    }
+    pthread_join(th, NULL);
+    sema_destroy(&ctx.sem_main);
+    sema_destroy(&ctx.sem_worker);
+}
+
+#if defined(__linux__)
+// futex 唤醒：waiter 阻塞在 FUTEX_WAIT，main 记下时间戳后 FUTEX_WAKE，
+// waiter 醒来后读表，差值 = 唤醒路径 + 调度到可运行的延迟
+typedef struct {
+    atomic_int        word;     // 0 = 继续睡，1 = 已唤醒
+    atomic_int        done;     // waiter 已完成的轮数
+    _Atomic uint64_t  stamp;    // main 发起 FUTEX_WAKE 前的时间戳
+    size_t            rounds;
+    latency_hist*     h;
+} futex_ctx;
+
+static void* futex_waiter(void* arg){
+    futex_ctx* f = (futex_ctx*)arg;
+    for (size_t r=0; r<f->rounds; ++r) {
+        while (atomic_load(&f->word) == 0)
+            syscall(SYS_futex, (int*)&f->word, FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+        uint64_t t1 = now_ns();
+        hist_record(f->h, t1 - atomic_load(&f->stamp));
+        atomic_store(&f->word, 0);
+        atomic_store(&f->done, (int)r + 1);
+    }
+    return NULL;
+}
+
+static void sleep_us(long us){
+    struct timespec ts = { 0, us * 1000L };
+    nanosleep(&ts, NULL);
+}
+
+static void hist_futex_wake(latency_hist* h, size_t rounds){
+    futex_ctx f;
+    atomic_init(&f.word, 0);
+    atomic_init(&f.done, 0);
+    atomic_init(&f.stamp, 0);
+    f.rounds = rounds;
+    f.h = h;
+    hist_reset(h);
+
+    pthread_t th;
+    if (pthread_create(&th, NULL, futex_waiter, &f) != 0){ fprintf(stderr,"pthread_create failed\n"); exit(1); }
+    for (size_t r=0; r<rounds; ++r) {
+        // 等上一轮结束，再留出时间让 waiter 真正进入 FUTEX_WAIT
+        while (atomic_load(&f.done) < (int)r) sleep_us(10);
+        sleep_us(50);
+        atomic_store(&f.stamp, now_ns());
+        atomic_store(&f.word, 1);
+        syscall(SYS_futex, (int*)&f.word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+    pthread_join(th, NULL);
+}
+#endif
+
+// DRAM miss：在远大于 LLC 的随机环上追指针，每一步单独计时（含 TLB miss）
+// 下一个地址与 t0 做假依赖（& 运行时的 0），保证 load 不会在读表之前发出；
+// 读表本身（Linux vDSO 的 rdtsc_ordered / macOS 的 mach_absolute_time）会等之前的 load 完成
+#define CHASE_BYTES (128ull*1024*1024)
+static volatile uint64_t chase_sink;
+
+static void hist_dram_miss(latency_hist* h, size_t n){
+    const size_t lines = CHASE_BYTES / 64;
+    uint64_t* ring = (uint64_t*)aligned_alloc(64, CHASE_BYTES);
+    uint32_t* order = (uint32_t*)malloc(lines * sizeof(uint32_t));
+    if (!ring || !order){ fprintf(stderr,"allocation failed\n"); exit(1); }
+    for (size_t i=0;i<lines;++i) order[i] = (uint32_t)i;
+    for (size_t i=lines-1;i>0;--i){
+        size_t j = (((size_t)rand() << 16) ^ (size_t)rand()) % (i + 1);
+        uint32_t t = order[i]; order[i] = order[j]; order[j] = t;
+    }
+    for (size_t i=0;i<lines;++i)
+        ring[(size_t)order[i]*8] = (uint64_t)order[(i + 1) % lines] * 8;
+    free(order);
+
+    static volatile uint64_t zero_mask = 0;
+    const uint64_t z = zero_mask;
+    const uint64_t tovh = timer_overhead_ns();
+    hist_reset(h);
+
+    uint64_t p = 0;
+    for (size_t i=0;i<1000;++i) p = ring[p];
+    for (size_t i=0;i<n;++i){
+        uint64_t t0 = now_ns();
+        p = ring[p | (t0 & z)];
+        uint64_t t1 = now_ns();
+        hist_record(h, net_ns(t0, t1, tovh));
+    }
+    chase_sink = p;
+    free(ring);
+}
+
 int main(void){
     // A) 系统调用往返
     size_t N_sys = 50000ull; // 200 万次，Apple Silicon 可轻松完成；慢的话降到 1e6
@@ -181,5 +358,29 @@ int main(void){
     double cs_ns = thread_switch_ns(N_rounds);
     printf("[Thread ping-pong]  context switch : %.1f ns/switch\n", cs_ns);
 
+    // C) 单次操作延迟分布
+    latency_hist* h = (latency_hist*)malloc(sizeof(latency_hist));
+    printf("\n[Per-operation latency] ns, log-bucketed histogram (bucket error < %.1f%%)\n",
+           100.0 / HIST_SUB_BUCKETS);
+    hist_print_header();
+
+    hist_syscall(h, 200000);
+    hist_print_row("syscall getpid()", h);
+
+    hist_thread_switch(h, 20000);
+    hist_print_row("context switch (RTT/2)", h);
+
+#if defined(__linux__)
+    hist_futex_wake(h, 5000);
+    hist_print_row("futex wake -> waiter running", h);
+#else
+    printf("  %-30s n/a (futex is Linux-only)\n", "futex wake -> waiter running");
+#endif
+
+    hist_dram_miss(h, 200000);
+    hist_print_row("DRAM miss (random chase)", h);
+
+    free(h);
+
     return 0;
 }
\ No newline at end of file
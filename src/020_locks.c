@@ -0,0 +1,337 @@
+// 020_locks.c
+// 实验目的：比较常见锁 / 同步原语在多线程下的扩展性
+// 锁：pthread mutex、pthread rwlock（全写 / 全读）、TTAS 自旋锁（指数退避）、
+//     ticket lock、MCS 队列锁、基于 futex 的互斥锁（仅 Linux）
+// 变量：线程数、临界区长度、临界区外“思考”时间（hold/think 比例）
+// 输出：吞吐、公平性（各线程获取次数的 min/max）、获取锁延迟的 p50 / p99 / max
+//   （每次获取都写入 harness 的对数直方图，覆盖整个时间窗，p50 / p99 为所在桶上界）
+// 线程框架同 017/018/019：绑核、同时启动、固定时间窗口
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "harness.h"
+
+#if defined(__linux__)
+  #include <unistd.h>
+  #include <sys/syscall.h>
+  #include <linux/futex.h>
+#endif
+
+#define WINDOW_MS   200
+#define MAX_THREADS 256
+
+// 自旋等待时的 CPU 提示
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ volatile("pause");
+#elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#endif
+}
+
+// 忙等 k 次迭代，用来模拟临界区 / 思考时间
+static inline void spin_work(int k) {
+    for (int i = 0; i < k; i++) __asm__ volatile("");
+}
+
+/*
+   -------- 锁实现 --------
+   所有锁使用同一组接口；MCS 需要每线程一个队列节点，其他锁忽略该参数
+*/
+typedef struct mcs_node {
+    _Atomic(struct mcs_node *) next;
+    atomic_int                 locked;
+} mcs_node;
+
+typedef struct {
+    _Alignas(64) atomic_int        word;        // TTAS / futex
+    _Alignas(64) atomic_uint       next_ticket;
+    _Alignas(64) atomic_uint       now_serving;
+    _Alignas(64) _Atomic(mcs_node *) tail;
+    _Alignas(64) pthread_mutex_t   mutex;
+    pthread_rwlock_t               rwlock;
+} lock_state;
+
+static lock_state the_lock;
+
+// pthread mutex
+static void mutex_lock(mcs_node *n)   { (void)n; pthread_mutex_lock(&the_lock.mutex); }
+static void mutex_unlock(mcs_node *n) { (void)n; pthread_mutex_unlock(&the_lock.mutex); }
+
+// pthread rwlock
+static void rw_wrlock(mcs_node *n) { (void)n; pthread_rwlock_wrlock(&the_lock.rwlock); }
+static void rw_rdlock(mcs_node *n) { (void)n; pthread_rwlock_rdlock(&the_lock.rwlock); }
+static void rw_unlock(mcs_node *n) { (void)n; pthread_rwlock_unlock(&the_lock.rwlock); }
+
+// TTAS：先只读自旋，看到空闲再尝试 exchange，失败后指数退避
+static void ttas_lock(mcs_node *n) {
+    (void)n;
+    int backoff = 4;
+    for (;;) {
+        while (atomic_load_explicit(&the_lock.word, memory_order_relaxed)) cpu_relax();
+        if (!atomic_exchange_explicit(&the_lock.word, 1, memory_order_acquire)) return;
+        for (int i = 0; i < backoff; i++) cpu_relax();
+        if (backoff < 1024) backoff *= 2;
+    }
+}
+
+static void ttas_unlock(mcs_node *n) {
+    (void)n;
+    atomic_store_explicit(&the_lock.word, 0, memory_order_release);
+}
+
+// ticket lock：严格 FIFO
+static void ticket_lock(mcs_node *n) {
+    (void)n;
+    unsigned me = atomic_fetch_add_explicit(&the_lock.next_ticket, 1, memory_order_relaxed);
+    while (atomic_load_explicit(&the_lock.now_serving, memory_order_acquire) != me) cpu_relax();
+}
+
+static void ticket_unlock(mcs_node *n) {
+    (void)n;
+    unsigned s = atomic_load_explicit(&the_lock.now_serving, memory_order_relaxed);
+    atomic_store_explicit(&the_lock.now_serving, s + 1, memory_order_release);
+}
+
+// MCS：每个等待者在自己的节点上自旋
+static void mcs_lock(mcs_node *me) {
+    atomic_store_explicit(&me->next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&me->locked, 1, memory_order_relaxed);
+    mcs_node *prev = atomic_exchange_explicit(&the_lock.tail, me, memory_order_acq_rel);
+    if (!prev) return;
+    atomic_store_explicit(&prev->next, me, memory_order_release);
+    while (atomic_load_explicit(&me->locked, memory_order_acquire)) cpu_relax();
+}
+
+static void mcs_unlock(mcs_node *me) {
+    mcs_node *succ = atomic_load_explicit(&me->next, memory_order_acquire);
+    if (!succ) {
+        mcs_node *expected = me;
+        if (atomic_compare_exchange_strong_explicit(&the_lock.tail, &expected, NULL,
+                memory_order_acq_rel, memory_order_acquire))
+            return;
+        while (!(succ = atomic_load_explicit(&me->next, memory_order_acquire))) cpu_relax();
+    }
+    atomic_store_explicit(&succ->locked, 0, memory_order_release);
+}
+
+#if defined(__linux__)
+// futex 互斥锁（Drepper “Futexes Are Tricky” 中的 mutex3）
+// 0 = 空闲，1 = 持有且无等待者，2 = 持有且可能有等待者
+static void futex_wait(atomic_int *addr, int val) {
+    syscall(SYS_futex, (int *)addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_int *addr, int n) {
+    syscall(SYS_futex, (int *)addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+static void futex_lock(mcs_node *n) {
+    (void)n;
+    int c = 0;
+    if (atomic_compare_exchange_strong_explicit(&the_lock.word, &c, 1,
+            memory_order_acquire, memory_order_relaxed))
+        return;
+    if (c != 2) c = atomic_exchange_explicit(&the_lock.word, 2, memory_order_acquire);
+    while (c != 0) {
+        futex_wait(&the_lock.word, 2);
+        c = atomic_exchange_explicit(&the_lock.word, 2, memory_order_acquire);
+    }
+}
+
+static void futex_unlock(mcs_node *n) {
+    (void)n;
+    if (atomic_fetch_sub_explicit(&the_lock.word, 1, memory_order_release) != 1) {
+        atomic_store_explicit(&the_lock.word, 0, memory_order_release);
+        futex_wake(&the_lock.word, 1);
+    }
+}
+#endif
+
+typedef struct {
+    const char *name;
+    void (*lock)(mcs_node *);
+    void (*unlock)(mcs_node *);
+    int         shared;     // 1 表示读锁，多个持有者可同时进入（不检查计数）
+} lock_ops;
+
+static const lock_ops locks[] = {
+    { "mutex",     mutex_lock,  mutex_unlock,  0 },
+    { "rwlock-wr", rw_wrlock,   rw_unlock,     0 },
+    { "rwlock-rd", rw_rdlock,   rw_unlock,     1 },
+    { "ttas",      ttas_lock,   ttas_unlock,   0 },
+    { "ticket",    ticket_lock, ticket_unlock, 0 },
+    { "mcs",       mcs_lock,    mcs_unlock,    0 },
+#if defined(__linux__)
+    { "futex",     futex_lock,  futex_unlock,  0 },
+#endif
+};
+
+/*
+   -------- 线程与测量 --------
+*/
+typedef struct {
+    int                 cpu;
+    const lock_ops     *ops;
+    int                 cs_work;        // 临界区内忙等迭代数
+    int                 think_work;     // 临界区外忙等迭代数
+    volatile int       *start;
+    volatile int       *stop;
+    uint64_t            acquired;
+    latency_hist       *lat;            // 获取延迟（ns），整个时间窗内每次获取都记录
+    double              seconds;
+} thread_arg;
+
+static volatile uint64_t protected_counter;   // 由锁保护
+
+static void *run_locker(void *arg) {
+    thread_arg *a = (thread_arg *)arg;
+    pin_thread_to_cpu(a->cpu);
+    mcs_node node;
+    const lock_ops *ops = a->ops;
+
+    while (!*a->start) { /* spin */ }
+
+    uint64_t count = 0;
+    hist_reset(a->lat);
+    uint64_t t0 = now_ns();
+    while (!*a->stop) {
+        uint64_t l0 = now_ns();
+        ops->lock(&node);
+        uint64_t l1 = now_ns();
+
+        protected_counter++;
+        spin_work(a->cs_work);
+        ops->unlock(&node);
+
+        hist_record(a->lat, l1 - l0);
+        count++;
+        spin_work(a->think_work);
+    }
+    uint64_t t1 = now_ns();
+
+    a->acquired = count;
+    a->seconds = (double)(t1 - t0) / 1e9;
+    return NULL;
+}
+
+static int thread_counts(int max, int *out) {
+    int n = 0;
+    for (int t = 1; t < max; t *= 2) out[n++] = t;
+    out[n++] = max;
+    return n;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void reset_lock(void) {
+    atomic_store(&the_lock.word, 0);
+    atomic_store(&the_lock.next_ticket, 0);
+    atomic_store(&the_lock.now_serving, 0);
+    atomic_store(&the_lock.tail, NULL);
+    protected_counter = 0;
+}
+
+int main(void) {
+    int ncpu = num_online_cpus();
+    int max_threads = ncpu < MAX_THREADS ? ncpu : MAX_THREADS;
+
+    // 临界区 / 思考时间（忙等迭代数）
+    static const struct { const char *label; int cs, think; } workloads[] = {
+        { "short/none",  10,   0    },
+        { "short/long",  10,   1000 },
+        { "long/long",   1000, 1000 },
+    };
+
+    printf("[20] Lock & Synchronization Primitive Scaling\n");
+    printf("Online CPUs: %d, window = %d ms, CS/think in busy-loop iterations\n", ncpu, WINDOW_MS);
+    if (pin_thread_to_cpu(0) != 0)
+        printf("NOTE: thread pinning unavailable on this platform; threads float.\n");
+#if !defined(__linux__)
+    printf("NOTE: futex lock is Linux-only and skipped.\n");
+#endif
+    printf("Fairness = min/max acquisitions across threads (1.00 = perfectly fair)\n\n");
+
+    pthread_mutex_init(&the_lock.mutex, NULL);
+    pthread_rwlock_init(&the_lock.rwlock, NULL);
+
+    thread_arg *args = calloc(MAX_THREADS, sizeof(thread_arg));
+    pthread_t *th = calloc(MAX_THREADS, sizeof(pthread_t));
+    latency_hist *lat_all = malloc(sizeof(latency_hist));
+    for (int i = 0; i < MAX_THREADS; i++) args[i].lat = malloc(sizeof(latency_hist));
+
+    int counts[32];
+    int num_counts = thread_counts(max_threads, counts);
+
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+        printf("=== CS/think = %s (%d / %d) ===\n", workloads[w].label, workloads[w].cs, workloads[w].think);
+        printf("%-10s %7s %12s %9s %10s %10s %12s\n",
+               "Lock", "Threads", "Mops/s", "Fairness", "p50 ns", "p99 ns", "max ns");
+        printf("---------------------------------------------------------------------------\n");
+
+        for (size_t l = 0; l < sizeof(locks) / sizeof(locks[0]); l++) {
+            for (int c = 0; c < num_counts; c++) {
+                int n = counts[c];
+                volatile int start = 0, stop = 0;
+                reset_lock();
+
+                for (int i = 0; i < n; i++) {
+                    args[i].cpu = i % ncpu;
+                    args[i].ops = &locks[l];
+                    args[i].cs_work = workloads[w].cs;
+                    args[i].think_work = workloads[w].think;
+                    args[i].start = &start;
+                    args[i].stop = &stop;
+                    pthread_create(&th[i], NULL, run_locker, &args[i]);
+                }
+                start = 1;
+                sleep_ms(WINDOW_MS);
+                stop = 1;
+                for (int i = 0; i < n; i++) pthread_join(th[i], NULL);
+
+                double rate = 0;
+                uint64_t total = 0, mn = UINT64_MAX, mx = 0;
+                hist_reset(lat_all);
+                for (int i = 0; i < n; i++) {
+                    rate += (double)args[i].acquired / args[i].seconds;
+                    total += args[i].acquired;
+                    if (args[i].acquired < mn) mn = args[i].acquired;
+                    if (args[i].acquired > mx) mx = args[i].acquired;
+                    hist_merge(lat_all, args[i].lat);
+                }
+
+                printf("%-10s %7d %12.3f %9.2f ", locks[l].name, n, rate / 1e6,
+                       mx ? (double)mn / (double)mx : 0.0);
+                if (lat_all->total == 0)
+                    printf("%10s %10s %12s\n", "-", "-", "-");
+                else
+                    printf("%10llu %10llu %12llu\n",
+                           (unsigned long long)hist_percentile(lat_all, 50),
+                           (unsigned long long)hist_percentile(lat_all, 99),
+                           (unsigned long long)lat_all->max);
+                if (!locks[l].shared && protected_counter != total)
+                    printf("  WARNING: %s lost updates (%llu != %llu)\n", locks[l].name,
+                           (unsigned long long)protected_counter, (unsigned long long)total);
+                fflush(stdout);
+            }
+        }
+        printf("\n");
+    }
+
+    for (int i = 0; i < MAX_THREADS; i++) free(args[i].lat);
+    free(lat_all);
+    free(args);
+    free(th);
+    pthread_rwlock_destroy(&the_lock.rwlock);
+    pthread_mutex_destroy(&the_lock.mutex);
+    return 0;
+}
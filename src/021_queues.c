@@ -0,0 +1,455 @@
+// 021_queues.c
+// 实验目的：测量无锁环形队列在线程间传递消息的单向延迟和吞吐
+// 队列：
+//   spsc ：单生产者单消费者 Lamport 环，生产者/消费者各自缓存对方的下标，批量发布时只写一次下标
+//   mpmc ：有界 MPMC 环（每个槽带序号，Vyukov 算法），这里同样只用一个生产者和一个消费者，
+//          用来对比通用队列相对 SPSC 多出的开销
+// 方法：
+//   A) 延迟：两条队列 A->B、B->A 做 ping-pong，记录每次往返时间，单向延迟 = RTT / 2
+//   B) 吞吐：生产者按批次 (batch) 连续写入 N 条消息，消费者按同样的批次取出并校验序号
+//   变量：消息大小 8 / 64 / 256 / 1024 B，批次 1 / 8 / 32，
+//         线程摆放：SMT 兄弟、同一 LLC 的不同物理核、跨 socket（拓扑来自 sysfs，找不到就跳过）
+// 线程框架同 017..020：绑核、spin 等待 start
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "harness.h"
+
+#define REPEAT      3
+#define RING_SLOTS  1024            // 必须是 2 的幂
+#define MAX_MSG     1024
+#define MAX_BATCH   32
+#define LAT_ROUNDS  100000          // 每组延迟测量的往返次数
+#define LAT_WARMUP  1000
+#define TPUT_BYTES  (256u << 20)    // 吞吐测试每次大约搬运的字节数
+#define TPUT_MAX    (4u << 20)      // 吞吐测试消息条数上限
+#define MAX_LIST    256
+
+// 自旋等待时的 CPU 提示
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ volatile("pause");
+#elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#endif
+}
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+   -------- 队列实现 --------
+   两种队列使用同一组接口：
+     push：阻塞直到 n 条消息全部放入
+     pop ：不阻塞，最多取 max 条，返回实际条数
+   消息大小在运行时确定，槽位步长 = 消息大小向上取整到 8B
+*/
+typedef struct {
+    _Alignas(64) atomic_size_t head;    // 消费者写
+    size_t                     tail_cache;
+    _Alignas(64) atomic_size_t tail;    // 生产者写
+    size_t                     head_cache;
+    _Alignas(64) uint8_t      *buf;
+    size_t                     msg, stride;
+} spsc_ring;
+
+static void spsc_push(void *q_, const uint8_t *src, size_t n) {
+    spsc_ring *q = q_;
+    size_t t = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    while (t + n - q->head_cache > RING_SLOTS) {
+        q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+        if (t + n - q->head_cache > RING_SLOTS) cpu_relax();
+    }
+    for (size_t i = 0; i < n; i++)
+        memcpy(q->buf + ((t + i) & (RING_SLOTS - 1)) * q->stride, src + i * q->msg, q->msg);
+    atomic_store_explicit(&q->tail, t + n, memory_order_release);
+}
+
+static size_t spsc_pop(void *q_, uint8_t *dst, size_t max) {
+    spsc_ring *q = q_;
+    size_t h = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (q->tail_cache == h) {
+        q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (q->tail_cache == h) return 0;
+    }
+    size_t n = q->tail_cache - h;
+    if (n > max) n = max;
+    for (size_t i = 0; i < n; i++)
+        memcpy(dst + i * q->msg, q->buf + ((h + i) & (RING_SLOTS - 1)) * q->stride, q->msg);
+    atomic_store_explicit(&q->head, h + n, memory_order_release);
+    return n;
+}
+
+// MPMC：槽位 = 8B 序号 + 消息
+typedef struct {
+    _Alignas(64) atomic_size_t enq_pos;
+    _Alignas(64) atomic_size_t deq_pos;
+    _Alignas(64) uint8_t      *buf;
+    size_t                     msg, stride;
+} mpmc_ring;
+
+static inline atomic_size_t *mpmc_seq(mpmc_ring *q, size_t pos) {
+    return (atomic_size_t *)(q->buf + (pos & (RING_SLOTS - 1)) * q->stride);
+}
+
+static void mpmc_push(void *q_, const uint8_t *src, size_t n) {
+    mpmc_ring *q = q_;
+    for (size_t i = 0; i < n; i++) {
+        size_t pos = atomic_load_explicit(&q->enq_pos, memory_order_relaxed);
+        atomic_size_t *seq;
+        for (;;) {
+            seq = mpmc_seq(q, pos);
+            intptr_t diff = (intptr_t)atomic_load_explicit(seq, memory_order_acquire) - (intptr_t)pos;
+            if (diff == 0) {
+                if (atomic_compare_exchange_weak_explicit(&q->enq_pos, &pos, pos + 1,
+                        memory_order_relaxed, memory_order_relaxed))
+                    break;
+            } else {
+                if (diff < 0) cpu_relax();          // 队列满，等消费者
+                pos = atomic_load_explicit(&q->enq_pos, memory_order_relaxed);
+            }
+        }
+        memcpy((uint8_t *)seq + 8, src + i * q->msg, q->msg);
+        atomic_store_explicit(seq, pos + 1, memory_order_release);
+    }
+}
+
+static size_t mpmc_pop(void *q_, uint8_t *dst, size_t max) {
+    mpmc_ring *q = q_;
+    size_t got = 0;
+    while (got < max) {
+        size_t pos = atomic_load_explicit(&q->deq_pos, memory_order_relaxed);
+        atomic_size_t *seq;
+        for (;;) {
+            seq = mpmc_seq(q, pos);
+            intptr_t diff = (intptr_t)atomic_load_explicit(seq, memory_order_acquire) - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (atomic_compare_exchange_weak_explicit(&q->deq_pos, &pos, pos + 1,
+                        memory_order_relaxed, memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return got;                         // 队列空
+            } else {
+                pos = atomic_load_explicit(&q->deq_pos, memory_order_relaxed);
+            }
+        }
+        memcpy(dst + got * q->msg, (uint8_t *)seq + 8, q->msg);
+        atomic_store_explicit(seq, pos + RING_SLOTS, memory_order_release);
+        got++;
+    }
+    return got;
+}
+
+typedef struct {
+    const char *name;
+    void      (*push)(void *q, const uint8_t *src, size_t n);
+    size_t    (*pop)(void *q, uint8_t *dst, size_t max);
+} queue_ops;
+
+static const queue_ops queues[] = {
+    { "spsc", spsc_push, spsc_pop },
+    { "mpmc", mpmc_push, mpmc_pop },
+};
+
+// 槽位缓冲区的最大尺寸：RING_SLOTS * (8B 序号 + MAX_MSG)
+#define RING_BUF_BYTES ((size_t)RING_SLOTS * (8 + MAX_MSG))
+
+typedef union {
+    spsc_ring spsc;
+    mpmc_ring mpmc;
+} any_ring;
+
+static void queue_reset(int kind, any_ring *r, uint8_t *buf, size_t msg) {
+    size_t stride = (msg + 7) & ~(size_t)7;
+    memset(r, 0, sizeof(*r));
+    if (kind == 0) {
+        r->spsc.buf = buf;
+        r->spsc.msg = msg;
+        r->spsc.stride = stride;
+    } else {
+        r->mpmc.buf = buf;
+        r->mpmc.msg = msg;
+        r->mpmc.stride = stride + 8;
+        for (size_t i = 0; i < RING_SLOTS; i++)
+            atomic_store_explicit(mpmc_seq(&r->mpmc, i), i, memory_order_relaxed);
+    }
+}
+
+/*
+   -------- 测试线程 --------
+   消息的前 8 字节是序号，消费者据此检查丢失 / 乱序
+*/
+typedef struct {
+    const queue_ops *ops;
+    void            *q_out;         // 本线程写入的队列
+    void            *q_in;          // 本线程读取的队列（延迟测试用）
+    int              cpu;
+    size_t           msg;
+    size_t           batch;
+    size_t           count;         // 消息 / 往返次数
+    volatile int    *start;
+    uint64_t        *lat;           // 延迟样本（只有发起方填写）
+    uint64_t         errors;
+    double           seconds;
+} thread_arg;
+
+static void *lat_initiator(void *arg) {
+    thread_arg *a = arg;
+    uint8_t msg[MAX_MSG] = { 0 }, in[MAX_MSG];
+    pin_thread_to_cpu(a->cpu);
+    while (!*a->start) { /* spin */ }
+
+    for (size_t i = 0; i < LAT_WARMUP + a->count; i++) {
+        memcpy(msg, &i, sizeof(i));
+        uint64_t t0 = now_ns();
+        a->ops->push(a->q_out, msg, 1);
+        while (a->ops->pop(a->q_in, in, 1) == 0) cpu_relax();
+        uint64_t t1 = now_ns();
+        if (memcmp(in, &i, sizeof(i)) != 0) a->errors++;
+        if (i >= LAT_WARMUP) a->lat[i - LAT_WARMUP] = t1 - t0;
+    }
+    return NULL;
+}
+
+static void *lat_echo(void *arg) {
+    thread_arg *a = arg;
+    uint8_t buf[MAX_MSG];
+    pin_thread_to_cpu(a->cpu);
+    while (!*a->start) { /* spin */ }
+
+    for (size_t i = 0; i < LAT_WARMUP + a->count; i++) {
+        while (a->ops->pop(a->q_in, buf, 1) == 0) cpu_relax();
+        a->ops->push(a->q_out, buf, 1);
+    }
+    return NULL;
+}
+
+static void *tput_producer(void *arg) {
+    thread_arg *a = arg;
+    uint8_t msgs[MAX_BATCH * MAX_MSG] = { 0 };
+    pin_thread_to_cpu(a->cpu);
+    while (!*a->start) { /* spin */ }
+
+    for (size_t i = 0; i < a->count; i += a->batch) {
+        size_t n = a->count - i < a->batch ? a->count - i : a->batch;
+        for (size_t k = 0; k < n; k++) {
+            uint64_t seq = i + k;
+            memcpy(msgs + k * a->msg, &seq, sizeof(seq));
+        }
+        a->ops->push(a->q_out, msgs, n);
+    }
+    return NULL;
+}
+
+static void *tput_consumer(void *arg) {
+    thread_arg *a = arg;
+    uint8_t msgs[MAX_BATCH * MAX_MSG];
+    pin_thread_to_cpu(a->cpu);
+    while (!*a->start) { /* spin */ }
+
+    uint64_t expect = 0, errors = 0;
+    uint64_t t0 = now_ns();
+    while (expect < a->count) {
+        size_t n = a->ops->pop(a->q_in, msgs, a->batch);
+        if (n == 0) {
+            cpu_relax();
+            continue;
+        }
+        for (size_t k = 0; k < n; k++, expect++) {
+            uint64_t seq;
+            memcpy(&seq, msgs + k * a->msg, sizeof(seq));
+            if (seq != expect) errors++;
+        }
+    }
+    uint64_t t1 = now_ns();
+
+    a->errors = errors;
+    a->seconds = (double)(t1 - t0) / 1e9;
+    return NULL;
+}
+
+// 启动一对线程并等待结束
+static void run_pair(void *(*fa)(void *), thread_arg *a, void *(*fb)(void *), thread_arg *b) {
+    pthread_t ta, tb;
+    volatile int start = 0;
+    a->start = &start;
+    b->start = &start;
+    pthread_create(&ta, NULL, fa, a);
+    pthread_create(&tb, NULL, fb, b);
+    start = 1;
+    pthread_join(ta, NULL);
+    pthread_join(tb, NULL);
+}
+
+/*
+   -------- 线程摆放 --------
+*/
+typedef struct {
+    const char *name;
+    int         cpu_a, cpu_b;
+} placement;
+
+static int in_list(int cpu, const int *list, int n) {
+    for (int i = 0; i < n; i++) if (list[i] == cpu) return 1;
+    return 0;
+}
+
+// 以 cpu0 为一端，依次寻找 SMT 兄弟、共享 LLC 的其他物理核、其他 socket 上的 CPU
+static int find_placements(int ncpu, placement *out) {
+    int np = 0;
+    static int smt[MAX_LIST], llc[MAX_LIST];
+    int nsmt = cpu_smt_siblings(0, smt, MAX_LIST);
+    int nllc = cpu_llc_siblings(0, llc, MAX_LIST);
+    int pkg0 = cpu_package_id(0);
+
+    for (int i = 0; i < nsmt; i++)
+        if (smt[i] != 0 && smt[i] < ncpu) { out[np++] = (placement){ "smt-sibling", 0, smt[i] }; break; }
+    for (int i = 0; i < nllc; i++)
+        if (llc[i] < ncpu && !in_list(llc[i], smt, nsmt)) { out[np++] = (placement){ "same-llc", 0, llc[i] }; break; }
+    for (int cpu = 1; cpu < ncpu && pkg0 >= 0; cpu++) {
+        int pkg = cpu_package_id(cpu);
+        if (pkg >= 0 && pkg != pkg0) { out[np++] = (placement){ "cross-socket", 0, cpu }; break; }
+    }
+    return np;
+}
+
+static const size_t msg_sizes[] = { 8, 64, 256, 1024 };
+static const size_t batches[]   = { 1, 8, 32 };
+#define NUM_SIZES   (sizeof(msg_sizes) / sizeof(msg_sizes[0]))
+#define NUM_BATCHES (sizeof(batches) / sizeof(batches[0]))
+
+int main(void) {
+    int ncpu = num_online_cpus();
+
+    printf("[21] Lock-Free SPSC / MPMC Queue Latency & Throughput\n");
+    printf("Online CPUs: %d, ring = %d slots\n", ncpu, RING_SLOTS);
+    if (ncpu < 2) {
+        printf("NOTE: needs at least 2 online CPUs (both sides busy-poll); skipped.\n");
+        return 0;
+    }
+
+    placement places[3];
+    int np;
+    if (pin_thread_to_cpu(0) != 0) {
+        printf("NOTE: thread pinning unavailable on this platform; threads float.\n");
+        places[0] = (placement){ "unpinned", 0, 1 };
+        np = 1;
+    } else {
+        np = find_placements(ncpu, places);
+        const char *wanted[] = { "smt-sibling", "same-llc", "cross-socket" };
+        for (int w = 0; w < 3; w++) {
+            int found = 0;
+            for (int p = 0; p < np; p++) if (strcmp(places[p].name, wanted[w]) == 0) found = 1;
+            if (!found) printf("NOTE: no CPU found for %s placement; skipped.\n", wanted[w]);
+        }
+    }
+    for (int p = 0; p < np; p++)
+        printf("  placement %-12s : cpu %d <-> cpu %d\n", places[p].name, places[p].cpu_a, places[p].cpu_b);
+    printf("\n");
+
+    any_ring *ra = aligned_alloc(64, sizeof(any_ring));
+    any_ring *rb = aligned_alloc(64, sizeof(any_ring));
+    uint8_t *buf_a = aligned_alloc(64, RING_BUF_BYTES);
+    uint8_t *buf_b = aligned_alloc(64, RING_BUF_BYTES);
+    uint64_t *lat = malloc(LAT_ROUNDS * sizeof(uint64_t));
+    if (!ra || !rb || !buf_a || !buf_b || !lat) {
+        fprintf(stderr, "allocation failed\n");
+        return 1;
+    }
+    memset(buf_a, 0, RING_BUF_BYTES);
+    memset(buf_b, 0, RING_BUF_BYTES);
+
+    printf("A) One-way latency (ping-pong RTT / 2, %d round trips)\n", LAT_ROUNDS);
+    printf("  %-5s %-12s %6s %10s %10s %10s %10s\n",
+           "Queue", "Placement", "Msg B", "p50 ns", "p90 ns", "p99 ns", "max ns");
+    printf("  ---------------------------------------------------------------------\n");
+    for (size_t k = 0; k < sizeof(queues) / sizeof(queues[0]); k++) {
+        for (int p = 0; p < np; p++) {
+            for (size_t s = 0; s < NUM_SIZES; s++) {
+                queue_reset((int)k, ra, buf_a, msg_sizes[s]);
+                queue_reset((int)k, rb, buf_b, msg_sizes[s]);
+                thread_arg a = { .ops = &queues[k], .q_out = ra, .q_in = rb, .cpu = places[p].cpu_a,
+                                 .msg = msg_sizes[s], .count = LAT_ROUNDS, .lat = lat };
+                thread_arg b = { .ops = &queues[k], .q_out = rb, .q_in = ra, .cpu = places[p].cpu_b,
+                                 .msg = msg_sizes[s], .count = LAT_ROUNDS };
+                run_pair(lat_initiator, &a, lat_echo, &b);
+
+                qsort(lat, LAT_ROUNDS, sizeof(uint64_t), cmp_u64);
+                printf("  %-5s %-12s %6zu %10.1f %10.1f %10.1f %10.1f\n",
+                       queues[k].name, places[p].name, msg_sizes[s],
+                       lat[LAT_ROUNDS / 2] / 2.0,
+                       lat[(size_t)(LAT_ROUNDS * 0.90)] / 2.0,
+                       lat[(size_t)(LAT_ROUNDS * 0.99)] / 2.0,
+                       lat[LAT_ROUNDS - 1] / 2.0);
+                if (a.errors)
+                    printf("  WARNING: %llu corrupted round trips\n", (unsigned long long)a.errors);
+                fflush(stdout);
+            }
+        }
+    }
+    printf("\n");
+
+    printf("B) Throughput (producer -> consumer, median of %d runs)\n", REPEAT);
+    printf("  %-5s %-12s %6s %6s %12s %10s\n",
+           "Queue", "Placement", "Msg B", "Batch", "Mmsg/s", "GB/s");
+    printf("  -----------------------------------------------------------\n");
+    for (size_t k = 0; k < sizeof(queues) / sizeof(queues[0]); k++) {
+        for (int p = 0; p < np; p++) {
+            for (size_t s = 0; s < NUM_SIZES; s++) {
+                size_t count = TPUT_BYTES / msg_sizes[s];
+                if (count > TPUT_MAX) count = TPUT_MAX;
+
+                for (size_t b = 0; b < NUM_BATCHES; b++) {
+                    double samples[REPEAT];
+                    uint64_t errors = 0;
+                    for (int r = 0; r < REPEAT; r++) {
+                        queue_reset((int)k, ra, buf_a, msg_sizes[s]);
+                        thread_arg prod = { .ops = &queues[k], .q_out = ra, .cpu = places[p].cpu_a,
+                                            .msg = msg_sizes[s], .batch = batches[b], .count = count };
+                        thread_arg cons = { .ops = &queues[k], .q_in = ra, .cpu = places[p].cpu_b,
+                                            .msg = msg_sizes[s], .batch = batches[b], .count = count };
+                        run_pair(tput_producer, &prod, tput_consumer, &cons);
+                        samples[r] = (double)count / cons.seconds;
+                        errors += cons.errors;
+                    }
+                    double rate = median(samples, REPEAT);
+                    printf("  %-5s %-12s %6zu %6zu %12.2f %10.2f\n",
+                           queues[k].name, places[p].name, msg_sizes[s], batches[b],
+                           rate / 1e6, rate * (double)msg_sizes[s] / 1e9);
+                    if (errors)
+                        printf("  WARNING: %llu out-of-order messages\n", (unsigned long long)errors);
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+    printf("\n");
+
+    free(ra);
+    free(rb);
+    free(buf_a);
+    free(buf_b);
+    free(lat);
+    return 0;
+}
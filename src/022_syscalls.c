@@ -0,0 +1,273 @@
+// 022_syscalls.c
+// 实验目的：系统调用开销目录（01_context_switch.c 只测了 getpid）
+// 每个调用单独计时写入 harness 的对数直方图，报告 mean / p50 / p90 / p99 / p99.9 / max：
+//   A) 时间与进程：getpid、clock_gettime（vDSO） vs 强制走 syscall
+//   B) I/O：/dev/zero 的 read / write、pipe 写入再读出，数据量 1 B .. 64 KiB
+//   C) 同步 / 调度 / 内存：无等待者的 futex wake、sched_yield、mmap + munmap、epoll_wait(0)
+//   D) io_uring：NOP 的 submit + 等待完成，每批 1 / 8 / 32 个（内核不支持时跳过）
+// 用来判断 I/O 层需要多大的批量才能摊薄进入内核的固定开销（含当前内核的漏洞缓解）
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "harness.h"
+
+#if defined(__linux__)
+  #include <sys/epoll.h>
+  #include <linux/futex.h>
+  #if __has_include(<linux/io_uring.h>)
+    #include <linux/io_uring.h>
+    #define HAVE_IO_URING 1
+  #endif
+#endif
+
+#define ITERS       100000      // 便宜调用的样本数
+#define ITERS_SLOW  20000       // 大块 I/O / mmap 的样本数
+#define MAX_IO      65536
+
+static int      zero_fd = -1;
+static int      pipe_fd[2] = { -1, -1 };
+static uint8_t *io_buf;
+static size_t   io_size;
+
+/*
+   -------- 被测操作：每个函数执行一次调用 --------
+*/
+static void op_getpid(void) { (void)syscall(SYS_getpid); }
+
+static void op_clock_vdso(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+}
+
+#if defined(__linux__)
+static void op_clock_syscall(void) {
+    struct timespec ts;
+    syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts);
+}
+#endif
+
+static void op_read_zero(void)  { (void)!read(zero_fd, io_buf, io_size); }
+static void op_write_zero(void) { (void)!write(zero_fd, io_buf, io_size); }
+
+// 写入 io_size 字节再读回来（一次 write + 一次 read）
+static void op_pipe_rw(void) {
+    (void)!write(pipe_fd[1], io_buf, io_size);
+    size_t got = 0;
+    while (got < io_size) {
+        ssize_t n = read(pipe_fd[0], io_buf + got, io_size - got);
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+}
+
+static void op_sched_yield(void) { sched_yield(); }
+
+static void op_mmap_munmap(void) {
+    void *p = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p != MAP_FAILED) munmap(p, 4096);
+}
+
+#if defined(__linux__)
+static int futex_word;
+static int epoll_fd = -1;
+
+static void op_futex_wake(void) {
+    syscall(SYS_futex, &futex_word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// 注册了一个空 pipe 读端的 epoll，超时 0：只测进出内核和就绪表检查
+static void op_epoll_wait(void) {
+    struct epoll_event ev;
+    epoll_wait(epoll_fd, &ev, 1, 0);
+}
+#endif
+
+/*
+   -------- io_uring：直接用原始系统调用（不依赖 liburing） --------
+*/
+#if defined(HAVE_IO_URING)
+static struct {
+    int                  fd;
+    unsigned            *sq_tail, *sq_mask, *sq_array;
+    unsigned            *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+} ring = { .fd = -1 };
+
+static unsigned uring_batch;
+
+static int uring_init(unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) return -1;
+
+    size_t sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (cq_sz > sq_sz) sq_sz = cq_sz;
+        cq_sz = sq_sz;
+    }
+    uint8_t *sq = mmap(NULL, sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) { close(fd); return -1; }
+    uint8_t *cq = sq;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(NULL, cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) { close(fd); return -1; }
+    }
+    void *sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) { close(fd); return -1; }
+
+    ring.fd       = fd;
+    ring.sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    ring.sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring.sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring.cq_head  = (unsigned *)(cq + p.cq_off.head);
+    ring.cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    ring.cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring.sqes     = sqes;
+    ring.cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+// 提交 uring_batch 个 NOP，一次 io_uring_enter 等全部完成，再收割 CQ
+static void op_uring_nop(void) {
+    unsigned tail = *ring.sq_tail;
+    for (unsigned i = 0; i < uring_batch; i++, tail++) {
+        unsigned idx = tail & *ring.sq_mask;
+        memset(&ring.sqes[idx], 0, sizeof(ring.sqes[idx]));
+        ring.sqes[idx].opcode = IORING_OP_NOP;
+        ring.sq_array[idx] = idx;
+    }
+    __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+    syscall(__NR_io_uring_enter, ring.fd, uring_batch, uring_batch, IORING_ENTER_GETEVENTS, NULL, 0);
+
+    unsigned head = *ring.cq_head;
+    unsigned ctail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+    __atomic_store_n(ring.cq_head, head + (ctail - head), __ATOMIC_RELEASE);
+}
+#endif
+
+/*
+   -------- 计时 --------
+   per_op > 1 时记录的是一批操作的平均值（摊薄后的单次开销）
+*/
+static latency_hist hist;
+
+static void measure(const char *label, void (*fn)(void), size_t iters, unsigned per_op) {
+    const uint64_t tovh = timer_overhead_ns();
+    for (size_t i = 0; i < iters / 10; i++) fn();     // 预热
+
+    hist_reset(&hist);
+    for (size_t i = 0; i < iters; i++) {
+        uint64_t t0 = now_ns();
+        fn();
+        uint64_t t1 = now_ns();
+        uint64_t d = t1 - t0;
+        hist_record(&hist, (d > tovh ? d - tovh : 0) / per_op);
+    }
+    hist_print_row(label, &hist);
+    fflush(stdout);
+}
+
+static const size_t io_sizes[] = { 1, 64, 4096, 65536 };
+#define NUM_IO_SIZES (sizeof(io_sizes) / sizeof(io_sizes[0]))
+
+int main(void) {
+    printf("[22] System Call Cost Catalog\n");
+    printf("Per-call latency in ns (each call timed individually, timer overhead %llu ns subtracted)\n\n",
+           (unsigned long long)timer_overhead_ns());
+
+    io_buf = aligned_alloc(4096, MAX_IO);
+    zero_fd = open("/dev/zero", O_RDWR);
+    if (!io_buf || zero_fd < 0 || pipe(pipe_fd) != 0) {
+        fprintf(stderr, "setup failed (/dev/zero or pipe)\n");
+        return 1;
+    }
+    memset(io_buf, 1, MAX_IO);
+#if defined(__linux__)
+    // 默认 pipe 容量即 64 KiB，这里显式设一次，保证最大一档能一次写完
+    fcntl(pipe_fd[1], F_SETPIPE_SZ, MAX_IO);
+#endif
+    char label[64];
+
+    printf("A) Time & process\n");
+    hist_print_header();
+    measure("getpid (syscall)", op_getpid, ITERS, 1);
+    measure("clock_gettime (vDSO)", op_clock_vdso, ITERS, 1);
+#if defined(__linux__)
+    measure("clock_gettime (forced syscall)", op_clock_syscall, ITERS, 1);
+#else
+    printf("  %-30s n/a (no raw clock_gettime syscall)\n", "clock_gettime (forced syscall)");
+#endif
+    printf("\n");
+
+    printf("B) I/O (/dev/zero, pipe write+read)\n");
+    hist_print_header();
+    for (size_t s = 0; s < NUM_IO_SIZES; s++) {
+        io_size = io_sizes[s];
+        size_t iters = io_size >= 4096 ? ITERS_SLOW : ITERS;
+        snprintf(label, sizeof(label), "read /dev/zero %zu B", io_size);
+        measure(label, op_read_zero, iters, 1);
+        snprintf(label, sizeof(label), "write /dev/zero %zu B", io_size);
+        measure(label, op_write_zero, iters, 1);
+        snprintf(label, sizeof(label), "pipe write+read %zu B", io_size);
+        measure(label, op_pipe_rw, iters, 1);
+    }
+    printf("\n");
+
+    printf("C) Synchronization, scheduling, memory\n");
+    hist_print_header();
+#if defined(__linux__)
+    measure("futex wake (no waiters)", op_futex_wake, ITERS, 1);
+#else
+    printf("  %-30s n/a (futex is Linux-only)\n", "futex wake (no waiters)");
+#endif
+    measure("sched_yield", op_sched_yield, ITERS, 1);
+    measure("mmap+munmap 4 KiB", op_mmap_munmap, ITERS_SLOW, 1);
+#if defined(__linux__)
+    epoll_fd = epoll_create1(0);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = pipe_fd[0] };
+    if (epoll_fd >= 0 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pipe_fd[0], &ev) == 0)
+        measure("epoll_wait (timeout 0)", op_epoll_wait, ITERS, 1);
+    else
+        printf("  %-30s n/a (epoll setup failed)\n", "epoll_wait (timeout 0)");
+#else
+    printf("  %-30s n/a (epoll is Linux-only)\n", "epoll_wait (timeout 0)");
+#endif
+    printf("\n");
+
+    printf("D) io_uring NOP submit + wait (batched rows are per NOP)\n");
+#if defined(HAVE_IO_URING)
+    if (uring_init(64) == 0) {
+        hist_print_header();
+        static const unsigned batches[] = { 1, 8, 32 };
+        for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+            uring_batch = batches[b];
+            snprintf(label, sizeof(label), "io_uring NOP, batch %u", uring_batch);
+            measure(label, op_uring_nop, ITERS_SLOW, uring_batch);
+        }
+    } else {
+        printf("NOTE: io_uring_setup failed (kernel too old, disabled, or blocked by seccomp); skipped.\n");
+    }
+#else
+    printf("NOTE: io_uring is Linux-only; skipped.\n");
+#endif
+    printf("\n");
+
+    close(zero_fd);
+    close(pipe_fd[0]);
+    close(pipe_fd[1]);
+    free(io_buf);
+    return 0;
+}
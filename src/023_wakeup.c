@@ -0,0 +1,311 @@
+// 023_wakeup.c
+// 实验目的：测量线程睡眠 / 被唤醒的真实延迟（C-state 退出、timer slack、调度延迟都会计入）
+// 01 的 ping-pong 让 CPU 一直忙，看不到这部分；结果用来决定线程池应该 spin、spin-then-park 还是直接 park
+//   A) 定时睡眠：请求睡眠 1 us .. 10 ms，记录超睡量 = 实际 - 请求
+//      nanosleep（相对）、clock_nanosleep（绝对时间）、futex 超时、epoll_wait 超时、timerfd 阻塞 read，
+//      另外把 timer slack 设成 1 ns 再测一次 nanosleep
+//   B) 唤醒阻塞线程：waiter 在另一个 CPU 上阻塞，空闲一段时间（10 us .. 50 ms）后由主线程唤醒，
+//      记录从发起唤醒到 waiter 开始运行的延迟；对比 spin（不睡）、futex、pthread 条件变量
+// 分布用 harness 的对数直方图输出 mean / p50 / p90 / p99 / p99.9 / max（单位 ns）
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "harness.h"
+
+#if defined(__linux__)
+  #include <sys/syscall.h>
+  #include <sys/epoll.h>
+  #include <sys/timerfd.h>
+  #include <sys/prctl.h>
+  #include <linux/futex.h>
+#endif
+
+#define CELL_BUDGET_NS  (200ull * 1000 * 1000)    // 每个格子大约花的时间
+#define MIN_SAMPLES     20
+#define MAX_SAMPLES     2000
+
+// 自旋等待时的 CPU 提示
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ volatile("pause");
+#elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#endif
+}
+
+static size_t samples_for(uint64_t period_ns) {
+    size_t n = (size_t)(CELL_BUDGET_NS / period_ns);
+    if (n < MIN_SAMPLES) n = MIN_SAMPLES;
+    if (n > MAX_SAMPLES) n = MAX_SAMPLES;
+    return n;
+}
+
+static struct timespec ns_to_ts(uint64_t ns) {
+    struct timespec ts = { (time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull) };
+    return ts;
+}
+
+static void sleep_ns(uint64_t ns) {
+    struct timespec ts = ns_to_ts(ns);
+    nanosleep(&ts, NULL);
+}
+
+/*
+   -------- A) 定时睡眠：每种机制睡 d 纳秒 --------
+*/
+static void sleep_nanosleep(uint64_t d) { sleep_ns(d); }
+
+#if defined(__linux__)
+static int clock_abs_err;           // clock_nanosleep 返回的非 EINTR 错误
+
+static void sleep_clock_abs(uint64_t d) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t target = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec + d;
+    struct timespec ts = ns_to_ts(target);
+    int r;
+    while ((r = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR) { }
+    if (r != 0) clock_abs_err = r;
+}
+
+static int futex_word;
+
+static void sleep_futex(uint64_t d) {
+    struct timespec ts = ns_to_ts(d);
+    syscall(SYS_futex, &futex_word, FUTEX_WAIT_PRIVATE, 0, &ts, NULL, 0);
+}
+
+static int epoll_fd = -1;
+static int epoll_ns_timeout;        // 内核支持 epoll_pwait2（ns 精度超时）
+
+static void sleep_epoll(uint64_t d) {
+    struct epoll_event ev;
+#if defined(SYS_epoll_pwait2)
+    if (epoll_ns_timeout) {
+        struct timespec ts = ns_to_ts(d);
+        syscall(SYS_epoll_pwait2, epoll_fd, &ev, 1, &ts, NULL, 0);
+        return;
+    }
+#endif
+    // 老接口只有毫秒精度，向上取整
+    epoll_wait(epoll_fd, &ev, 1, (int)((d + 999999) / 1000000));
+}
+
+static int timer_fd = -1;
+
+static void sleep_timerfd(uint64_t d) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value = ns_to_ts(d);
+    timerfd_settime(timer_fd, 0, &its, NULL);
+    uint64_t expirations;
+    (void)!read(timer_fd, &expirations, sizeof(expirations));
+}
+#endif
+
+static const uint64_t sleep_durations[] = {
+    1000, 10000, 50000, 100000, 500000, 1000000, 10000000
+};
+#define NUM_DURATIONS (sizeof(sleep_durations) / sizeof(sleep_durations[0]))
+
+static latency_hist hist;
+
+static void format_duration(char *buf, size_t n, uint64_t ns) {
+    if (ns >= 1000000) snprintf(buf, n, "%llu ms", (unsigned long long)(ns / 1000000));
+    else               snprintf(buf, n, "%llu us", (unsigned long long)(ns / 1000));
+}
+
+static void run_sleep(const char *name, void (*fn)(uint64_t)) {
+    for (size_t i = 0; i < NUM_DURATIONS; i++) {
+        uint64_t d = sleep_durations[i];
+        size_t n = samples_for(d);
+        hist_reset(&hist);
+        for (size_t k = 0; k < n; k++) {
+            uint64_t t0 = now_ns();
+            fn(d);
+            uint64_t t1 = now_ns();
+            uint64_t elapsed = t1 - t0;
+            hist_record(&hist, elapsed > d ? elapsed - d : 0);
+        }
+        char label[64], dur[32];
+        format_duration(dur, sizeof(dur), d);
+        snprintf(label, sizeof(label), "%s %s", name, dur);
+        hist_print_row(label, &hist);
+        fflush(stdout);
+    }
+}
+
+/*
+   -------- B) 唤醒阻塞线程 --------
+   主线程空闲 idle 纳秒后记下时间戳并唤醒 waiter，waiter 醒来后记录差值
+*/
+enum { WAKE_SPIN, WAKE_FUTEX, WAKE_CONDVAR, NUM_WAKE };
+static const char *wake_names[NUM_WAKE] = { "spin", "futex", "condvar" };
+
+typedef struct {
+    int               kind;
+    int               cpu;
+    size_t            rounds;
+    atomic_int        flag;         // 1 = 已唤醒
+    atomic_int        done;         // waiter 已完成的轮数
+    _Atomic uint64_t  stamp;
+    pthread_mutex_t   mu;
+    pthread_cond_t    cv;
+    latency_hist     *h;
+} wake_ctx;
+
+static void *waiter(void *arg) {
+    wake_ctx *w = arg;
+    pin_thread_to_cpu(w->cpu);
+    for (size_t r = 0; r < w->rounds; r++) {
+        switch (w->kind) {
+        case WAKE_SPIN:
+            while (!atomic_load_explicit(&w->flag, memory_order_acquire)) cpu_relax();
+            break;
+#if defined(__linux__)
+        case WAKE_FUTEX:
+            while (!atomic_load(&w->flag))
+                syscall(SYS_futex, (int *)&w->flag, FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+            break;
+#endif
+        case WAKE_CONDVAR:
+            pthread_mutex_lock(&w->mu);
+            while (!atomic_load(&w->flag)) pthread_cond_wait(&w->cv, &w->mu);
+            pthread_mutex_unlock(&w->mu);
+            break;
+        }
+        uint64_t t1 = now_ns();
+        hist_record(w->h, t1 - atomic_load(&w->stamp));
+        atomic_store(&w->flag, 0);
+        atomic_store(&w->done, (int)r + 1);
+    }
+    return NULL;
+}
+
+static void run_wake(int kind, uint64_t idle, int cpu, latency_hist *h) {
+    wake_ctx w;
+    memset(&w, 0, sizeof(w));
+    w.kind = kind;
+    w.cpu = cpu;
+    w.rounds = samples_for(idle);
+    w.h = h;
+    atomic_init(&w.flag, 0);
+    atomic_init(&w.done, 0);
+    pthread_mutex_init(&w.mu, NULL);
+    pthread_cond_init(&w.cv, NULL);
+    hist_reset(h);
+
+    pthread_t th;
+    pthread_create(&th, NULL, waiter, &w);
+    for (size_t r = 0; r < w.rounds; r++) {
+        while (atomic_load(&w.done) < (int)r) sleep_ns(10000);
+        sleep_ns(idle);                         // waiter 所在 CPU 空闲 idle 纳秒
+        atomic_store(&w.stamp, now_ns());
+        switch (kind) {
+        case WAKE_SPIN:
+            atomic_store_explicit(&w.flag, 1, memory_order_release);
+            break;
+#if defined(__linux__)
+        case WAKE_FUTEX:
+            atomic_store(&w.flag, 1);
+            syscall(SYS_futex, (int *)&w.flag, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+            break;
+#endif
+        case WAKE_CONDVAR:
+            pthread_mutex_lock(&w.mu);
+            atomic_store(&w.flag, 1);
+            pthread_cond_signal(&w.cv);
+            pthread_mutex_unlock(&w.mu);
+            break;
+        }
+    }
+    pthread_join(th, NULL);
+    pthread_mutex_destroy(&w.mu);
+    pthread_cond_destroy(&w.cv);
+}
+
+static const uint64_t idle_periods[] = { 10000, 100000, 1000000, 10000000, 50000000 };
+#define NUM_IDLE (sizeof(idle_periods) / sizeof(idle_periods[0]))
+
+int main(void) {
+    int ncpu = num_online_cpus();
+
+    printf("[23] Idle Wakeup Latency (sleep oversleep & blocked-thread wake)\n");
+    printf("All values in ns, log-bucketed histogram\n");
+    int pinned = pin_thread_to_cpu(0) == 0;
+    if (!pinned)
+        printf("NOTE: thread pinning unavailable on this platform; threads float.\n");
+    printf("\n");
+
+    printf("A) Oversleep = actual - requested sleep\n");
+#if defined(__linux__)
+    printf("   timer slack = %d ns (prctl PR_GET_TIMERSLACK)\n", prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0));
+#endif
+    hist_print_header();
+    run_sleep("nanosleep", sleep_nanosleep);
+#if defined(__linux__)
+    sleep_clock_abs(1000);              // 先试一次，失败就跳过整行
+    if (clock_abs_err == 0) run_sleep("clock_nanosleep abs", sleep_clock_abs);
+    else printf("  NOTE: clock_nanosleep failed (%s); clock_nanosleep rows skipped.\n", strerror(clock_abs_err));
+    run_sleep("futex timeout", sleep_futex);
+
+    epoll_fd = epoll_create1(0);
+#if defined(SYS_epoll_pwait2)
+    {
+        struct epoll_event ev;
+        struct timespec ts = { 0, 0 };
+        epoll_ns_timeout = syscall(SYS_epoll_pwait2, epoll_fd, &ev, 1, &ts, NULL, 0) == 0;
+    }
+#endif
+    if (!epoll_ns_timeout)
+        printf("  NOTE: epoll_pwait2 unavailable; epoll_wait timeout rounds up to whole ms.\n");
+    run_sleep("epoll_wait", sleep_epoll);
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+    if (timer_fd >= 0) run_sleep("timerfd read", sleep_timerfd);
+    else printf("  NOTE: timerfd_create failed; timerfd rows skipped.\n");
+
+    int old_slack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+    if (prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0) == 0) {
+        run_sleep("nanosleep slack=1ns", sleep_nanosleep);
+        prctl(PR_SET_TIMERSLACK, old_slack, 0, 0, 0);
+    }
+#else
+    printf("  NOTE: clock_nanosleep / futex / epoll / timerfd are Linux-only; skipped.\n");
+#endif
+    printf("\n");
+
+    // waiter 放在另一个 CPU 上，让它真正进入空闲；只有一个 CPU 时 spin 没有意义
+    int waiter_cpu = ncpu > 1 ? 1 : 0;
+    printf("B) Wake a blocked thread on cpu %d after an idle period (waker on cpu 0)\n", waiter_cpu);
+    if (ncpu < 2)
+        printf("   NOTE: only one online CPU; waker and waiter share it, spin rows skipped.\n");
+    hist_print_header();
+    for (int k = 0; k < NUM_WAKE; k++) {
+        if (k == WAKE_SPIN && ncpu < 2) continue;
+#if !defined(__linux__)
+        if (k == WAKE_FUTEX) {
+            printf("  %-30s n/a (futex is Linux-only)\n", "futex");
+            continue;
+        }
+#endif
+        for (size_t i = 0; i < NUM_IDLE; i++) {
+            char label[64], dur[32];
+            run_wake(k, idle_periods[i], waiter_cpu, &hist);
+            format_duration(dur, sizeof(dur), idle_periods[i]);
+            snprintf(label, sizeof(label), "%s, idle %s", wake_names[k], dur);
+            hist_print_row(label, &hist);
+            fflush(stdout);
+        }
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,239 @@
+// 024_os_noise.c
+// 实验目的：检测 OS 噪声 / 抖动（中断、软中断、调度、SMI 等），用于给延迟敏感服务认证主机
+// 方法：FWQ（fixed work quantum）：每个 CPU 上绑一个线程，反复执行固定工作量 warmup_busy_loop(q)，
+//   每个 quantum 用 now_ns() 计时；耗时超过基线（本 CPU 校准出的最短耗时）+ 阈值的部分记为一次 detour，
+//   记录其时间戳和长度
+//   FTQ（fixed time quantum）视角由同一份数据得到：按 1 ms 切帧，统计每帧完成的有效工作占比，
+//   报告最差帧
+// 用法：./bin/024_os_noise [秒数, 默认 2] [阈值 us, 默认 5] [detour CSV 输出路径, 可选]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "harness.h"
+
+#define MAX_THREADS  256
+#define MAX_DETOURS  65536      // 每 CPU 最多保存的 detour 条数，超出只计数
+#define QUANTUM_NS   10000      // 目标 quantum 长度
+#define CALIB_RUNS   2000
+#define FRAME_NS     1000000    // FTQ 帧长 1 ms
+#define TOP_N        10
+
+typedef struct {
+    uint64_t t;                 // 相对开始时刻 (ns)
+    uint64_t dur;               // 超出基线的时间 (ns)
+} detour;
+
+typedef struct {
+    int           cpu;
+    size_t        q_iters;
+    uint64_t      duration_ns;
+    uint64_t      threshold_ns;
+    volatile int *start;
+    uint64_t      t_start;      // 公共起点，所有 CPU 的时间戳对齐
+
+    // 结果
+    uint64_t      base_ns;      // 校准得到的最短 quantum
+    uint64_t      quanta;
+    uint64_t      noise_ns;     // 所有 detour 的时间总和
+    uint64_t      ndetours;     // 含超出 MAX_DETOURS 未保存的
+    detour       *detours;
+    uint32_t     *frame_quanta; // 每帧完成的 quantum 数
+    size_t        nframes;
+    latency_hist  hist;         // quantum 耗时分布
+} thread_arg;
+
+static void *run_fwq(void *arg) {
+    thread_arg *a = arg;
+    pin_thread_to_cpu(a->cpu);
+
+    // 基线：本 CPU 上连续执行 CALIB_RUNS 次取最短
+    uint64_t base = UINT64_MAX;
+    for (int i = 0; i < CALIB_RUNS; i++) {
+        uint64_t t0 = now_ns();
+        warmup_busy_loop(a->q_iters);
+        uint64_t d = now_ns() - t0;
+        if (d < base) base = d;
+    }
+    a->base_ns = base;
+    hist_reset(&a->hist);
+
+    while (!*a->start) { /* spin */ }
+
+    uint64_t end = a->t_start + a->duration_ns;
+    uint64_t t0 = now_ns();
+    while (t0 < end) {
+        warmup_busy_loop(a->q_iters);
+        uint64_t t1 = now_ns();
+        uint64_t d = t1 - t0;
+        hist_record(&a->hist, d);
+        a->quanta++;
+
+        size_t frame = (size_t)((t1 - a->t_start) / FRAME_NS);
+        if (frame < a->nframes) a->frame_quanta[frame]++;
+
+        if (d > base + a->threshold_ns) {
+            if (a->ndetours < MAX_DETOURS)
+                a->detours[a->ndetours] = (detour){ t0 - a->t_start, d - base };
+            a->ndetours++;
+            a->noise_ns += d - base;
+        }
+        t0 = t1;
+    }
+    return NULL;
+}
+
+static int cmp_detour_dur(const void *x, const void *y) {
+    const detour *a = x, *b = y;
+    return (a->dur < b->dur) - (a->dur > b->dur);     // 降序
+}
+
+// 以 cpu0 校准：多少次迭代大约是 QUANTUM_NS
+static size_t calibrate_quantum(void) {
+    size_t iters = 1000;
+    for (;;) {
+        uint64_t best = UINT64_MAX;
+        for (int i = 0; i < 50; i++) {
+            uint64_t t0 = now_ns();
+            warmup_busy_loop(iters);
+            uint64_t d = now_ns() - t0;
+            if (d < best) best = d;
+        }
+        if (best >= QUANTUM_NS / 4 || iters > ((size_t)1 << 30)) {
+            double scale = (double)QUANTUM_NS / (double)(best ? best : 1);
+            return (size_t)((double)iters * scale) + 1;
+        }
+        iters *= 4;
+    }
+}
+
+int main(int argc, char **argv) {
+    double seconds   = argc > 1 ? atof(argv[1]) : 2.0;
+    double thresh_us = argc > 2 ? atof(argv[2]) : 5.0;
+    const char *csv  = argc > 3 ? argv[3] : NULL;
+    if (seconds <= 0) seconds = 2.0;
+    if (thresh_us <= 0) thresh_us = 5.0;
+
+    int ncpu = num_online_cpus();
+    int n = ncpu < MAX_THREADS ? ncpu : MAX_THREADS;
+
+    printf("[24] OS Noise / Jitter Detector (FWQ, FTQ view)\n");
+    if (pin_thread_to_cpu(0) != 0)
+        printf("NOTE: thread pinning unavailable on this platform; threads float, per-CPU labels are nominal.\n");
+
+    size_t q_iters = calibrate_quantum();
+    uint64_t duration_ns = (uint64_t)(seconds * 1e9);
+    size_t nframes = (size_t)(duration_ns / FRAME_NS) + 1;
+    printf("CPUs: %d, duration = %.1f s, quantum ~ %d ns (%zu loop iters), threshold = %.1f us\n\n",
+           n, seconds, QUANTUM_NS, q_iters, thresh_us);
+
+    thread_arg *args = calloc((size_t)n, sizeof(thread_arg));
+    pthread_t *th = calloc((size_t)n, sizeof(pthread_t));
+    volatile int start = 0;
+    for (int i = 0; i < n; i++) {
+        args[i].cpu = i;
+        args[i].q_iters = q_iters;
+        args[i].duration_ns = duration_ns;
+        args[i].threshold_ns = (uint64_t)(thresh_us * 1000.0);
+        args[i].start = &start;
+        args[i].detours = malloc(MAX_DETOURS * sizeof(detour));
+        args[i].frame_quanta = calloc(nframes, sizeof(uint32_t));
+        args[i].nframes = nframes;
+        if (!args[i].detours || !args[i].frame_quanta) {
+            fprintf(stderr, "allocation failed\n");
+            return 1;
+        }
+    }
+    // 留出时间让每个线程完成各自的校准，再给出统一的起点
+    uint64_t t_start = now_ns() + 200ull * 1000 * 1000 + (uint64_t)CALIB_RUNS * QUANTUM_NS;
+    for (int i = 0; i < n; i++) {
+        args[i].t_start = t_start;
+        pthread_create(&th[i], NULL, run_fwq, &args[i]);
+    }
+    // 主线程睡到起点，避免自己成为 cpu0 上的噪声源
+    uint64_t now = now_ns();
+    if (now < t_start) {
+        struct timespec ts = { (time_t)((t_start - now) / 1000000000ull), (long)((t_start - now) % 1000000000ull) };
+        nanosleep(&ts, NULL);
+    }
+    start = 1;
+    for (int i = 0; i < n; i++) pthread_join(th[i], NULL);
+
+    printf("Per-CPU summary (quantum times in ns; noise = detour time / wall time)\n");
+    printf("%4s %10s %8s %8s %8s %9s %9s %8s %10s %9s\n",
+           "CPU", "quanta", "base", "p50", "p99", "p99.9", "detours", "noise%", "max us", "worst FTQ");
+    printf("-------------------------------------------------------------------------------------------\n");
+    for (int i = 0; i < n; i++) {
+        thread_arg *a = &args[i];
+        // FTQ：每帧有效工作 = 完成的 quantum 数 * 基线耗时；首尾两帧不完整，不参与
+        double worst = 1.0;
+        for (size_t f = 1; f + 1 < a->nframes; f++) {
+            double work = (double)a->frame_quanta[f] * (double)a->base_ns / (double)FRAME_NS;
+            if (work < worst) worst = work;
+        }
+        size_t saved = a->ndetours < MAX_DETOURS ? a->ndetours : MAX_DETOURS;
+        uint64_t mx = 0;
+        for (size_t k = 0; k < saved; k++) if (a->detours[k].dur > mx) mx = a->detours[k].dur;
+
+        printf("%4d %10llu %8llu %8llu %8llu %9llu %9llu %7.3f%% %10.1f %8.1f%%\n",
+               a->cpu, (unsigned long long)a->quanta, (unsigned long long)a->base_ns,
+               (unsigned long long)hist_percentile(&a->hist, 50.0),
+               (unsigned long long)hist_percentile(&a->hist, 99.0),
+               (unsigned long long)hist_percentile(&a->hist, 99.9),
+               (unsigned long long)a->ndetours,
+               100.0 * (double)a->noise_ns / (double)duration_ns,
+               (double)mx / 1000.0, 100.0 * worst);
+    }
+    printf("worst FTQ = least useful work completed in any %d ms frame\n\n", FRAME_NS / 1000000);
+
+    // 每个 CPU 最长的几次 detour
+    printf("Largest detours per CPU (t = ms since start, dur = us beyond base)\n");
+    for (int i = 0; i < n; i++) {
+        thread_arg *a = &args[i];
+        size_t saved = a->ndetours < MAX_DETOURS ? a->ndetours : MAX_DETOURS;
+        if (saved == 0) continue;
+        printf("  cpu %-3d:", a->cpu);
+
+        // 排序副本取最长的 TOP_N；原数组保持时间顺序，供 CSV 使用
+        detour *sorted = malloc(saved * sizeof(detour));
+        memcpy(sorted, a->detours, saved * sizeof(detour));
+        qsort(sorted, saved, sizeof(detour), cmp_detour_dur);
+        for (size_t k = 0; k < saved && k < TOP_N; k++)
+            printf(" %.2f/%.1f", (double)sorted[k].t / 1e6, (double)sorted[k].dur / 1000.0);
+        printf("\n");
+        free(sorted);
+    }
+    printf("\n");
+
+    if (csv) {
+        FILE *f = fopen(csv, "w");
+        if (!f) {
+            fprintf(stderr, "cannot open %s\n", csv);
+        } else {
+            fprintf(f, "cpu,t_ns,detour_ns\n");
+            for (int i = 0; i < n; i++) {
+                size_t saved = args[i].ndetours < MAX_DETOURS ? args[i].ndetours : MAX_DETOURS;
+                for (size_t k = 0; k < saved; k++)
+                    fprintf(f, "%d,%llu,%llu\n", args[i].cpu,
+                            (unsigned long long)args[i].detours[k].t,
+                            (unsigned long long)args[i].detours[k].dur);
+            }
+            fclose(f);
+            printf("Full detour log written to %s\n", csv);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (args[i].ndetours > MAX_DETOURS)
+            printf("NOTE: cpu %d had %llu detours, only the first %d were logged.\n", args[i].cpu,
+                   (unsigned long long)args[i].ndetours, MAX_DETOURS);
+        free(args[i].detours);
+        free(args[i].frame_quanta);
+    }
+    free(args);
+    free(th);
+    return 0;
+}
@@ -0,0 +1,333 @@
+// 025_page_faults.c
+// 实验目的：测量缺页与内存映射操作的开销（010 里用 memset 预热“避免缺页尖峰”，但从没量过这些缺页）
+//   A) 首次访问的 minor fault：每 4 KiB 一次（禁用 THP）、每个 2 MiB 大页一次（MADV_HUGEPAGE），
+//      以及 MAP_POPULATE 一次性预取的单页摊销开销
+//   B) fork 之后子进程写入共享页触发的写时复制 (COW) fault
+//   C) mprotect：对已填充的 4 KiB / 2 MiB / 64 MiB 区域切换 RW <-> R
+//   D) madvise(MADV_DONTNEED) 本身的开销，以及之后重新访问的 re-fault
+//   E) mmap + 访问 + munmap 循环，同一进程内另有 0..N-1 个线程在其他 CPU 上运行，
+//      munmap 需要向它们发 TLB shootdown
+// 逐次计时的项目写入 harness 的对数直方图（单位 ns）
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "harness.h"
+
+#define PAGE        4096ull
+#define HUGE_PAGE   (2ull << 20)
+#define FAULT_BYTES (256ull << 20)      // A/D 的区域大小
+#define HUGE_BYTES  (512ull << 20)
+#define COW_BYTES   (64ull << 20)
+#define SHOOT_PAGES 16                  // E) 每次映射的页数
+#define SHOOT_ITERS 20000
+#define MPROT_ITERS 2000
+#define MAX_THREADS 256
+
+static latency_hist hist;
+
+static uint8_t *map_anon(size_t bytes, int flags) {
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    return p;
+}
+
+// 每个 stride 写一个字节，每次写单独计时
+static void touch_timed(uint8_t *p, size_t bytes, size_t stride, latency_hist *h) {
+    const uint64_t tovh = timer_overhead_ns();
+    hist_reset(h);
+    for (size_t off = 0; off < bytes; off += stride) {
+        uint64_t t0 = now_ns();
+        p[off] = 1;
+        uint64_t t1 = now_ns();
+        uint64_t d = t1 - t0;
+        hist_record(h, d > tovh ? d - tovh : 0);
+    }
+}
+
+#if defined(__linux__)
+// 当前进程的 AnonHugePages（kB），用于确认 THP 真的生效
+static long anon_huge_kb(void) {
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f) return -1;
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) break;
+    fclose(f);
+    return kb;
+}
+#endif
+
+/*
+   -------- A) 首次访问 --------
+*/
+static void run_first_touch(void) {
+    printf("A) First-touch minor faults (ns per fault)\n");
+    hist_print_header();
+
+    uint8_t *p = map_anon(FAULT_BYTES, 0);
+#if defined(MADV_NOHUGEPAGE)
+    madvise(p, FAULT_BYTES, MADV_NOHUGEPAGE);
+#endif
+    touch_timed(p, FAULT_BYTES, PAGE, &hist);
+    hist_print_row("4 KiB page, first write", &hist);
+    munmap(p, FAULT_BYTES);
+
+    // 只读访问映射到共享零页，不分配物理页
+    p = map_anon(FAULT_BYTES, 0);
+#if defined(MADV_NOHUGEPAGE)
+    madvise(p, FAULT_BYTES, MADV_NOHUGEPAGE);
+#endif
+    {
+        const uint64_t tovh = timer_overhead_ns();
+        volatile uint8_t *vp = p;
+        hist_reset(&hist);
+        for (size_t off = 0; off < FAULT_BYTES; off += PAGE) {
+            uint64_t t0 = now_ns();
+            (void)vp[off];
+            uint64_t t1 = now_ns();
+            uint64_t d = t1 - t0;
+            hist_record(&hist, d > tovh ? d - tovh : 0);
+        }
+        hist_print_row("4 KiB page, first read (zero)", &hist);
+    }
+    munmap(p, FAULT_BYTES);
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    {
+        // 多映射一个大页再手动对齐到 2 MiB
+        uint8_t *raw = map_anon(HUGE_BYTES + HUGE_PAGE, 0);
+        uint8_t *hp = (uint8_t *)(((uintptr_t)raw + HUGE_PAGE - 1) & ~(uintptr_t)(HUGE_PAGE - 1));
+        madvise(hp, HUGE_BYTES, MADV_HUGEPAGE);
+        long before = anon_huge_kb();
+        touch_timed(hp, HUGE_BYTES, HUGE_PAGE, &hist);
+        long after = anon_huge_kb();
+        hist_print_row("2 MiB huge page, first write", &hist);
+        printf("  huge page amortized: %.1f ns per 4 KiB equivalent\n",
+               (double)hist.sum / (double)hist.total / (double)(HUGE_PAGE / PAGE));
+        if (before < 0 || after - before < (long)(HUGE_BYTES / 1024 / 2))
+            printf("  NOTE: THP did not back most of the region (AnonHugePages +%ld kB); "
+                   "check /sys/kernel/mm/transparent_hugepage/enabled.\n", after - before);
+        munmap(raw, HUGE_BYTES + HUGE_PAGE);
+    }
+#else
+    printf("  NOTE: transparent huge pages are Linux-only; huge-page row skipped.\n");
+#endif
+
+#if defined(MAP_POPULATE)
+    {
+        uint64_t t0 = now_ns();
+        uint8_t *pp = map_anon(FAULT_BYTES, MAP_POPULATE);
+        uint64_t t1 = now_ns();
+        printf("  mmap(MAP_POPULATE) amortized: %.1f ns per 4 KiB page\n",
+               (double)(t1 - t0) / (double)(FAULT_BYTES / PAGE));
+        munmap(pp, FAULT_BYTES);
+    }
+#endif
+    printf("\n");
+}
+
+/*
+   -------- B) fork 后的写时复制 --------
+   子进程逐页写入并计时，把直方图经 pipe 传回父进程打印
+*/
+static void run_cow(void) {
+    printf("B) Copy-on-write faults after fork (%llu MiB parent RSS, child writes every page)\n",
+           (unsigned long long)(COW_BYTES >> 20));
+    hist_print_header();
+
+    uint8_t *p = map_anon(COW_BYTES, 0);
+#if defined(MADV_NOHUGEPAGE)
+    madvise(p, COW_BYTES, MADV_NOHUGEPAGE);
+#endif
+    memset(p, 1, COW_BYTES);
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return;
+    }
+    fflush(stdout);
+    uint64_t t0 = now_ns();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        touch_timed(p, COW_BYTES, PAGE, &hist);
+        const uint8_t *src = (const uint8_t *)&hist;
+        size_t left = sizeof(hist);
+        while (left > 0) {
+            ssize_t n = write(fds[1], src, left);
+            if (n <= 0) break;
+            src += n;
+            left -= (size_t)n;
+        }
+        _exit(0);
+    }
+    uint64_t t_fork = now_ns() - t0;
+    close(fds[1]);
+    uint8_t *dst = (uint8_t *)&hist;
+    size_t got = 0;
+    while (got < sizeof(hist)) {
+        ssize_t n = read(fds[0], dst + got, sizeof(hist) - got);
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+
+    if (got == sizeof(hist)) hist_print_row("COW fault (child write)", &hist);
+    else printf("  WARNING: child did not report results\n");
+    printf("  fork() itself with %llu MiB mapped: %.1f us\n\n",
+           (unsigned long long)(COW_BYTES >> 20), (double)t_fork / 1000.0);
+    munmap(p, COW_BYTES);
+}
+
+/*
+   -------- C) mprotect --------
+*/
+static void run_mprotect(void) {
+    static const size_t sizes[] = { PAGE, HUGE_PAGE, 64ull << 20 };
+    printf("C) mprotect RW <-> R on a populated region (ns per call)\n");
+    printf("  %-12s %12s %12s\n", "Region", "ns/call", "ns/4K page");
+    printf("  ------------------------------------\n");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t bytes = sizes[i];
+        uint8_t *p = map_anon(bytes, 0);
+        memset(p, 1, bytes);
+        size_t iters = bytes > HUGE_PAGE ? MPROT_ITERS / 10 : MPROT_ITERS;
+
+        uint64_t t0 = now_ns();
+        for (size_t k = 0; k < iters; k++) {
+            mprotect(p, bytes, PROT_READ);
+            mprotect(p, bytes, PROT_READ | PROT_WRITE);
+        }
+        uint64_t t1 = now_ns();
+        double ns = (double)(t1 - t0) / (double)(2 * iters);
+        char label[32];
+        if (bytes >= (1ull << 20)) snprintf(label, sizeof(label), "%zu MiB", bytes >> 20);
+        else                       snprintf(label, sizeof(label), "%zu KiB", bytes >> 10);
+        printf("  %-12s %12.1f %12.2f\n", label, ns, ns / (double)(bytes / PAGE));
+        munmap(p, bytes);
+    }
+    printf("\n");
+}
+
+/*
+   -------- D) MADV_DONTNEED 与 re-fault --------
+*/
+static void run_dontneed(void) {
+    printf("D) madvise(MADV_DONTNEED) on %llu MiB, then re-touch\n", (unsigned long long)(FAULT_BYTES >> 20));
+    hist_print_header();
+
+    uint8_t *p = map_anon(FAULT_BYTES, 0);
+#if defined(MADV_NOHUGEPAGE)
+    madvise(p, FAULT_BYTES, MADV_NOHUGEPAGE);
+#endif
+    memset(p, 1, FAULT_BYTES);
+
+    uint64_t t0 = now_ns();
+    madvise(p, FAULT_BYTES, MADV_DONTNEED);
+    uint64_t t1 = now_ns();
+
+    touch_timed(p, FAULT_BYTES, PAGE, &hist);
+    hist_print_row("re-fault after DONTNEED", &hist);
+    printf("  madvise(MADV_DONTNEED) itself: %.1f us total, %.1f ns per 4 KiB page\n\n",
+           (double)(t1 - t0) / 1000.0, (double)(t1 - t0) / (double)(FAULT_BYTES / PAGE));
+    munmap(p, FAULT_BYTES);
+}
+
+/*
+   -------- E) munmap 的 TLB shootdown --------
+   旁观线程在其他 CPU 上持续运行（读写自己的数据），使本进程的 mm 在这些 CPU 上处于活动状态
+*/
+typedef struct {
+    int           cpu;
+    volatile int *stop;
+} bystander_arg;
+
+static void *bystander(void *arg) {
+    bystander_arg *a = arg;
+    pin_thread_to_cpu(a->cpu);
+    volatile uint64_t local = 0;
+    while (!*a->stop) local++;
+    return NULL;
+}
+
+static int thread_counts(int max, int *out) {
+    int n = 0;
+    for (int t = 1; t < max; t *= 2) out[n++] = t;
+    out[n++] = max;
+    return n;
+}
+
+static void run_shootdown(int ncpu) {
+    int max_threads = ncpu < MAX_THREADS ? ncpu : MAX_THREADS;
+    int counts[32];
+    int num_counts = thread_counts(max_threads, counts);
+    bystander_arg args[MAX_THREADS];
+    pthread_t th[MAX_THREADS];
+    const size_t bytes = SHOOT_PAGES * PAGE;
+
+    printf("E) mmap + touch %d pages + munmap, with other threads of the process running (thread i on cpu i)\n",
+           SHOOT_PAGES);
+    hist_print_header();
+
+    for (int c = 0; c < num_counts; c++) {
+        int n = counts[c];
+        volatile int stop = 0;
+        for (int i = 1; i < n; i++) {
+            args[i] = (bystander_arg){ .cpu = i % ncpu, .stop = &stop };
+            pthread_create(&th[i], NULL, bystander, &args[i]);
+        }
+        // 等旁观线程都跑起来
+        struct timespec ts = { 0, 20L * 1000000L };
+        nanosleep(&ts, NULL);
+
+        const uint64_t tovh = timer_overhead_ns();
+        hist_reset(&hist);
+        for (int k = 0; k < SHOOT_ITERS; k++) {
+            uint64_t t0 = now_ns();
+            uint8_t *p = map_anon(bytes, 0);
+            for (size_t off = 0; off < bytes; off += PAGE) p[off] = 1;
+            munmap(p, bytes);
+            uint64_t t1 = now_ns();
+            uint64_t d = t1 - t0;
+            hist_record(&hist, d > tovh ? d - tovh : 0);
+        }
+        stop = 1;
+        for (int i = 1; i < n; i++) pthread_join(th[i], NULL);
+
+        char label[64];
+        snprintf(label, sizeof(label), "%d thread(s) in process", n);
+        hist_print_row(label, &hist);
+        fflush(stdout);
+    }
+    printf("\n");
+}
+
+int main(void) {
+    int ncpu = num_online_cpus();
+
+    printf("[25] Page Fault & Memory Mapping Costs\n");
+    printf("Page = 4 KiB, huge page = 2 MiB, online CPUs = %d; latencies in ns\n", ncpu);
+    if (pin_thread_to_cpu(0) != 0)
+        printf("NOTE: thread pinning unavailable on this platform; threads float.\n");
+    printf("\n");
+
+    run_first_touch();
+    run_cow();
+    run_mprotect();
+    run_dontneed();
+    run_shootdown(ncpu);
+    return 0;
+}
@@ -0,0 +1,493 @@
+// 026_allocators.c
+// 实验目的：比较系统 malloc 与两种自带分配器的开销，判断请求路径是否值得改用 arena
+//   malloc ：系统 malloc / free
+//   arena  ：每线程 bump 分配器，free 为空操作，请求结束时整体回卷 (reset)
+//   pool   ：每线程按 2 的幂分级的定长块池；本线程释放进本地空闲链表，
+//            其他线程释放进所属池的 remote 栈（无锁 MPSC），池空时一次性收回
+// 方法：
+//   A) 单线程尺寸扫描：一批分配（每个对象写 1 字节）后全部释放，ns / (alloc + free)
+//   B) 生产者 / 消费者：一个线程分配、经指针环传给另一个线程释放，ns / 对象，RSS 增长
+//   C) 请求式 churn：1..N 个线程，每个“请求”分配 64 个 16..1024 B 的随机大小对象，用完全部释放，
+//      报告总吞吐、每线程 ns / alloc 和 RSS 增长
+// 线程框架同 017..020：绑核、同时启动、固定时间窗口
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "harness.h"
+
+#define REPEAT        5
+#define WINDOW_MS     200
+#define MAX_THREADS   256
+#define ARENA_CHUNK   (4u << 20)        // arena 每次向系统要的块
+#define POOL_SLAB     (1u << 20)        // pool 每次切分的 slab
+#define NUM_CLASSES   15                // 16 B .. 256 KiB
+#define SWEEP_BYTES   (1ull << 30)      // A) 每个尺寸大约分配的总字节数
+#define SWEEP_MAX_OPS (1u << 20)
+#define XFER_COUNT    (1u << 20)        // B) 传递的对象数
+#define XFER_RING     1024
+#define REQ_OBJECTS   64                // C) 每个请求的对象数
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+// 当前常驻内存（KiB）；Linux 读 /proc/self/statm，其他平台退化为峰值 RSS
+static long rss_kb(void) {
+#if defined(__linux__)
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        long size, resident;
+        int ok = fscanf(f, "%ld %ld", &size, &resident) == 2;
+        fclose(f);
+        if (ok) return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+#endif
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#if defined(__APPLE__)
+    return ru.ru_maxrss / 1024;     // macOS 单位是字节
+#else
+    return ru.ru_maxrss;
+#endif
+}
+
+/*
+   -------- 分配器实现 --------
+*/
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+} arena_chunk;
+
+typedef struct {
+    uint8_t     *cur, *end;
+    arena_chunk *chunks;            // 链表头是当前块
+} arena;
+
+typedef struct pool_block {
+    struct pool_block *next;
+} pool_block;
+
+// owner 线程频繁改写的字段在前，remote 独占最后一条 cache line（_Alignas 让 sizeof 补齐到 64 的倍数），
+// 跨线程释放的原子操作不会和 owner 的分配路径伪共享
+typedef struct pool {
+    size_t                  stride;     // 块头 16 B + 块大小
+    pool_block             *free;       // 本线程空闲链表
+    uint8_t                *cur, *end;  // 当前 slab 未切分部分
+    arena_chunk            *slabs;
+    _Alignas(64) _Atomic(pool_block *) remote;   // 其他线程释放回来的块
+} pool;
+
+// pool 块头：记录所属池，跨线程释放时据此找到 owner
+typedef struct {
+    pool    *owner;
+    uint64_t pad;
+} pool_hdr;
+
+typedef struct {
+    arena a;
+    pool  pools[NUM_CLASSES];
+} alloc_ctx;
+
+static void ctx_init(alloc_ctx *c) {
+    memset(c, 0, sizeof(*c));
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        c->pools[i].stride = sizeof(pool_hdr) + ((size_t)16 << i);
+        atomic_init(&c->pools[i].remote, NULL);
+    }
+}
+
+static void free_chunks(arena_chunk *ch) {
+    while (ch) {
+        arena_chunk *next = ch->next;
+        free(ch);
+        ch = next;
+    }
+}
+
+static void ctx_destroy(alloc_ctx *c) {
+    free_chunks(c->a.chunks);
+    for (int i = 0; i < NUM_CLASSES; i++) free_chunks(c->pools[i].slabs);
+}
+
+static void *arena_alloc(arena *a, size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    if ((size_t)(a->end - a->cur) < size) {
+        size_t bytes = size + 64 > ARENA_CHUNK ? size + 64 : ARENA_CHUNK;
+        arena_chunk *ch = malloc(bytes);
+        if (!ch) return NULL;
+        ch->next = a->chunks;
+        a->chunks = ch;
+        a->cur = (uint8_t *)ch + 64;
+        a->end = (uint8_t *)ch + bytes;
+    }
+    void *p = a->cur;
+    a->cur += size;
+    return p;
+}
+
+// 回卷：只保留当前块
+static void arena_reset(arena *a) {
+    if (!a->chunks) return;
+    free_chunks(a->chunks->next);
+    a->chunks->next = NULL;
+    a->cur = (uint8_t *)a->chunks + 64;
+}
+
+// 16 B -> 0, 17..32 B -> 1, ...
+static inline int size_class(size_t size) {
+    if (size <= 16) return 0;
+    return 64 - __builtin_clzll((unsigned long long)(size - 1)) - 4;
+}
+
+static void *pool_alloc(pool *pl) {
+    pool_block *b = pl->free;
+    if (!b && atomic_load_explicit(&pl->remote, memory_order_relaxed)) {
+        // 本地链表空了：把 remote 栈整条取回，链头直接当作新的本地链表
+        b = atomic_exchange_explicit(&pl->remote, NULL, memory_order_acquire);
+    }
+    if (b) {
+        pl->free = b->next;
+        return b;
+    }
+    if ((size_t)(pl->end - pl->cur) < pl->stride) {
+        size_t bytes = pl->stride * 16 > POOL_SLAB ? pl->stride * 16 + 64 : POOL_SLAB;
+        arena_chunk *slab = malloc(bytes);
+        if (!slab) return NULL;
+        slab->next = pl->slabs;
+        pl->slabs = slab;
+        pl->cur = (uint8_t *)slab + 64;
+        pl->end = (uint8_t *)slab + bytes;
+    }
+    pool_hdr *h = (pool_hdr *)pl->cur;
+    pl->cur += pl->stride;
+    h->owner = pl;
+    return h + 1;
+}
+
+static void pool_free(alloc_ctx *c, void *p, int cls) {
+    pool_hdr *h = (pool_hdr *)p - 1;
+    pool *pl = h->owner;
+    pool_block *b = (pool_block *)p;
+    if (pl == &c->pools[cls]) {
+        b->next = pl->free;
+        pl->free = b;
+    } else {
+        pool_block *head = atomic_load_explicit(&pl->remote, memory_order_relaxed);
+        do {
+            b->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&pl->remote, &head, b,
+                     memory_order_release, memory_order_relaxed));
+    }
+}
+
+typedef struct {
+    const char *name;
+    void     *(*alloc)(alloc_ctx *c, size_t size);
+    void      (*free)(alloc_ctx *c, void *p, size_t size);
+    void      (*reset)(alloc_ctx *c);           // 一个请求结束
+} allocator;
+
+static void *m_alloc(alloc_ctx *c, size_t size) { (void)c; return malloc(size); }
+static void  m_free(alloc_ctx *c, void *p, size_t size) { (void)c; (void)size; free(p); }
+static void  no_reset(alloc_ctx *c) { (void)c; }
+
+static void *a_alloc(alloc_ctx *c, size_t size) { return arena_alloc(&c->a, size); }
+static void  a_free(alloc_ctx *c, void *p, size_t size) { (void)c; (void)p; (void)size; }
+static void  a_reset(alloc_ctx *c) { arena_reset(&c->a); }
+
+static void *p_alloc(alloc_ctx *c, size_t size) { return pool_alloc(&c->pools[size_class(size)]); }
+static void  p_free(alloc_ctx *c, void *p, size_t size) { pool_free(c, p, size_class(size)); }
+
+static const allocator allocators[] = {
+    { "malloc", m_alloc, m_free, no_reset },
+    { "arena",  a_alloc, a_free, a_reset  },
+    { "pool",   p_alloc, p_free, no_reset },
+};
+#define NUM_ALLOCATORS (sizeof(allocators) / sizeof(allocators[0]))
+
+/*
+   -------- A) 单线程尺寸扫描 --------
+*/
+static double sweep_ns(const allocator *al, size_t size, void **slots) {
+    size_t batch = (64u << 20) / size;
+    if (batch > 1024) batch = 1024;
+    size_t ops = SWEEP_BYTES / size;
+    if (ops > SWEEP_MAX_OPS) ops = SWEEP_MAX_OPS;
+    size_t rounds = (ops + batch - 1) / batch;
+
+    double samples[REPEAT];
+    for (int r = 0; r < REPEAT; r++) {
+        alloc_ctx ctx;
+        ctx_init(&ctx);
+        uint64_t t0 = now_ns();
+        for (size_t k = 0; k < rounds; k++) {
+            for (size_t i = 0; i < batch; i++) {
+                slots[i] = al->alloc(&ctx, size);
+                *(volatile uint8_t *)slots[i] = (uint8_t)i;
+            }
+            for (size_t i = 0; i < batch; i++) al->free(&ctx, slots[i], size);
+            al->reset(&ctx);
+        }
+        uint64_t t1 = now_ns();
+        ctx_destroy(&ctx);
+        samples[r] = (double)(t1 - t0) / (double)(rounds * batch);
+    }
+    return median(samples, REPEAT);
+}
+
+static void run_sweep(void) {
+    static const size_t sizes[] = { 16, 64, 256, 1024, 4096, 16384, 65536, 262144 };
+    void **slots = malloc(1024 * sizeof(void *));
+
+    printf("A) Size-class sweep, single thread: ns per alloc+free (batch alloc, touch, batch free)\n");
+    printf("  %8s", "Size");
+    for (size_t a = 0; a < NUM_ALLOCATORS; a++) printf(" %10s", allocators[a].name);
+    printf("\n  ------------------------------------------\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        printf("  %8zu", sizes[s]);
+        for (size_t a = 0; a < NUM_ALLOCATORS; a++)
+            printf(" %10.1f", sweep_ns(&allocators[a], sizes[s], slots));
+        printf("\n");
+        fflush(stdout);
+    }
+    printf("\n");
+    free(slots);
+}
+
+/*
+   -------- B) 生产者 / 消费者跨线程释放 --------
+   单生产者单消费者指针环；等待时先自旋再让出 CPU，单核机器上也能推进
+*/
+typedef struct {
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    _Alignas(64) void         *slot[XFER_RING];
+} ptr_ring;
+
+typedef struct {
+    const allocator *al;
+    alloc_ctx       *ctx;
+    ptr_ring        *ring;
+    int              cpu;
+    size_t           size;
+    volatile int    *start;
+} xfer_arg;
+
+static inline void wait_a_bit(unsigned *spins) {
+    if (++*spins > 256) {
+        sched_yield();
+        *spins = 0;
+    }
+}
+
+static void *xfer_producer(void *arg) {
+    xfer_arg *x = arg;
+    pin_thread_to_cpu(x->cpu);
+    while (!*x->start) { /* spin */ }
+    for (size_t i = 0; i < XFER_COUNT; i++) {
+        void *p = x->al->alloc(x->ctx, x->size);
+        *(volatile uint8_t *)p = (uint8_t)i;
+        size_t t = atomic_load_explicit(&x->ring->tail, memory_order_relaxed);
+        unsigned spins = 0;
+        while (t - atomic_load_explicit(&x->ring->head, memory_order_acquire) >= XFER_RING)
+            wait_a_bit(&spins);
+        x->ring->slot[t % XFER_RING] = p;
+        atomic_store_explicit(&x->ring->tail, t + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+static void *xfer_consumer(void *arg) {
+    xfer_arg *x = arg;
+    pin_thread_to_cpu(x->cpu);
+    while (!*x->start) { /* spin */ }
+    for (size_t i = 0; i < XFER_COUNT; i++) {
+        size_t h = atomic_load_explicit(&x->ring->head, memory_order_relaxed);
+        unsigned spins = 0;
+        while (atomic_load_explicit(&x->ring->tail, memory_order_acquire) == h)
+            wait_a_bit(&spins);
+        void *p = x->ring->slot[h % XFER_RING];
+        atomic_store_explicit(&x->ring->head, h + 1, memory_order_release);
+        x->al->free(x->ctx, p, x->size);
+    }
+    return NULL;
+}
+
+static void run_xfer(int ncpu) {
+    static const size_t sizes[] = { 64, 1024 };
+    ptr_ring *ring = aligned_alloc(64, sizeof(ptr_ring));
+
+    printf("B) Producer/consumer: thread on cpu 0 allocates, thread on cpu %d frees (%u objects)\n",
+           ncpu > 1 ? 1 : 0, XFER_COUNT);
+    printf("  %-8s %6s %12s %12s\n", "Alloc", "Size", "ns/object", "RSS +MiB");
+    printf("  ------------------------------------------\n");
+    for (size_t a = 0; a < NUM_ALLOCATORS; a++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            alloc_ctx *pc = aligned_alloc(64, sizeof(alloc_ctx)), *cc = aligned_alloc(64, sizeof(alloc_ctx));
+            ctx_init(pc);
+            ctx_init(cc);
+            atomic_init(&ring->head, 0);
+            atomic_init(&ring->tail, 0);
+            volatile int start = 0;
+            xfer_arg pa = { &allocators[a], pc, ring, 0, sizes[s], &start };
+            xfer_arg ca = { &allocators[a], cc, ring, ncpu > 1 ? 1 : 0, sizes[s], &start };
+
+            long rss0 = rss_kb();
+            pthread_t tp, tc;
+            pthread_create(&tp, NULL, xfer_producer, &pa);
+            pthread_create(&tc, NULL, xfer_consumer, &ca);
+            uint64_t t0 = now_ns();
+            start = 1;
+            pthread_join(tp, NULL);
+            pthread_join(tc, NULL);
+            uint64_t t1 = now_ns();
+            long rss1 = rss_kb();
+
+            printf("  %-8s %6zu %12.1f %12.1f\n", allocators[a].name, sizes[s],
+                   (double)(t1 - t0) / XFER_COUNT, (double)(rss1 - rss0) / 1024.0);
+            fflush(stdout);
+            ctx_destroy(pc);
+            ctx_destroy(cc);
+            free(pc);
+            free(cc);
+        }
+    }
+    printf("  (arena never reclaims cross-thread frees; pool returns them to the owner's remote list)\n\n");
+    free(ring);
+}
+
+/*
+   -------- C) 请求式 churn，1..N 线程 --------
+*/
+typedef struct {
+    const allocator *al;
+    int              cpu;
+    volatile int    *start;
+    volatile int    *stop;
+    uint64_t         allocs;
+    double           seconds;
+} churn_arg;
+
+static void *run_churn(void *arg) {
+    churn_arg *c = arg;
+    pin_thread_to_cpu(c->cpu);
+    alloc_ctx *ctx = aligned_alloc(64, sizeof(alloc_ctx));   // pool 要求 64 B 对齐
+    ctx_init(ctx);
+    void  *objs[REQ_OBJECTS];
+    size_t sizes[REQ_OBJECTS];
+    uint64_t x = 0x9E3779B97F4A7C15ull ^ (uint64_t)(c->cpu + 1);
+
+    while (!*c->start) { /* spin */ }
+    uint64_t allocs = 0;
+    uint64_t t0 = now_ns();
+    while (!*c->stop) {
+        for (int i = 0; i < REQ_OBJECTS; i++) {
+            x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+            sizes[i] = 16 + (size_t)(x % 1009);
+            objs[i] = c->al->alloc(ctx, sizes[i]);
+            *(volatile uint8_t *)objs[i] = (uint8_t)i;
+        }
+        for (int i = 0; i < REQ_OBJECTS; i++) c->al->free(ctx, objs[i], sizes[i]);
+        c->al->reset(ctx);
+        allocs += REQ_OBJECTS;
+    }
+    uint64_t t1 = now_ns();
+    c->allocs = allocs;
+    c->seconds = (double)(t1 - t0) / 1e9;
+    ctx_destroy(ctx);
+    free(ctx);
+    return NULL;
+}
+
+static int thread_counts(int max, int *out) {
+    int n = 0;
+    for (int t = 1; t < max; t *= 2) out[n++] = t;
+    out[n++] = max;
+    return n;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void run_churn_scaling(int ncpu) {
+    int max_threads = ncpu < MAX_THREADS ? ncpu : MAX_THREADS;
+    int counts[32];
+    int num_counts = thread_counts(max_threads, counts);
+    churn_arg *args = calloc(MAX_THREADS, sizeof(churn_arg));
+    pthread_t *th = calloc(MAX_THREADS, sizeof(pthread_t));
+
+    printf("C) Request churn: %d allocs of 16..1024 B per request, then free all (thread i on cpu i)\n",
+           REQ_OBJECTS);
+    printf("  %-8s %7s %14s %14s %10s\n", "Alloc", "Threads", "Total Mops/s", "ns/alloc/thr", "RSS +MiB");
+    printf("  ------------------------------------------------------------\n");
+    for (size_t a = 0; a < NUM_ALLOCATORS; a++) {
+        for (int c = 0; c < num_counts; c++) {
+            int n = counts[c];
+            volatile int start = 0, stop = 0;
+            long rss0 = rss_kb(), rss_peak = rss0;
+            for (int i = 0; i < n; i++) {
+                args[i] = (churn_arg){ .al = &allocators[a], .cpu = i % ncpu, .start = &start, .stop = &stop };
+                pthread_create(&th[i], NULL, run_churn, &args[i]);
+            }
+            start = 1;
+            // 窗口结束前采样 RSS（线程退出时会释放各自的 arena / pool）
+            sleep_ms(WINDOW_MS - 10);
+            long r = rss_kb();
+            if (r > rss_peak) rss_peak = r;
+            sleep_ms(10);
+            stop = 1;
+            for (int i = 0; i < n; i++) pthread_join(th[i], NULL);
+
+            double rate = 0, lat = 0;
+            for (int i = 0; i < n; i++) {
+                rate += (double)args[i].allocs / args[i].seconds;
+                lat += args[i].seconds * 1e9 / (double)args[i].allocs;
+            }
+            printf("  %-8s %7d %14.2f %14.1f %10.1f\n", allocators[a].name, n, rate / 1e6, lat / n,
+                   (double)(rss_peak - rss0) / 1024.0);
+            fflush(stdout);
+        }
+    }
+    printf("\n");
+    free(args);
+    free(th);
+}
+
+int main(void) {
+    int ncpu = num_online_cpus();
+
+    printf("[26] Allocator Benchmark: malloc vs bump arena vs per-thread pool\n");
+    printf("Online CPUs: %d\n", ncpu);
+    if (pin_thread_to_cpu(0) != 0)
+        printf("NOTE: thread pinning unavailable on this platform; threads float.\n");
+#if !defined(__linux__)
+    printf("NOTE: RSS columns use peak RSS (getrusage) on this platform.\n");
+#endif
+    printf("\n");
+
+    run_sweep();
+    run_xfer(ncpu);
+    run_churn_scaling(ncpu);
+    return 0;
+}
@@ -0,0 +1,471 @@
+// 027_memcpy.c
+// 实验目的：刻画批量拷贝 / 填充在不同大小、对齐、重叠和实现下的性能，找出各实现的分界点
+// 实现：
+//   copy ：libc memcpy、rep movsb（x86）、simd16（16B 向量，SSE2/NEON）、avx2（x86，运行时检测）、
+//          nt（非临时存储：x86 movntdq / arm64 stnp，绕过 cache）
+//   set  ：libc memset、rep stosb（x86）、simd16、nt
+// 方法：
+//   A) copy 大小扫描 1 B .. 1 GiB（2 的幂），同一对缓冲区反复拷贝，报告 GB/s 和每次调用的周期数，
+//      并列出每个大小区间的最优实现（分界点）
+//   B) memset 同样扫描
+//   C) 对齐：固定大小下改变 src / dst 相对 4 KiB 的偏移
+//   D) 重叠：memmove 前向 / 后向重叠不同距离，与不重叠的 memcpy 对比
+// 与 03 相同，用假定主频把时间换算成周期
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "harness.h"
+
+#if defined(__x86_64__)
+  #include <immintrin.h>
+#endif
+
+#define FREQ_GHZ     3.2
+#define MAX_BYTES    (1ull << 30)
+#define TARGET_BYTES (64ull << 20)      // 每次测量大约搬运的字节数
+#define MAX_CALLS    (1u << 20)
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+typedef void (*copy_fn)(void *dst, const void *src, size_t n);
+typedef void (*set_fn)(void *dst, int c, size_t n);
+
+/*
+   -------- 拷贝实现 --------
+*/
+// 经 volatile 函数指针调用，避免编译器把 libc 调用内联或改写
+static void *(*volatile libc_memcpy)(void *, const void *, size_t) = memcpy;
+static void *(*volatile libc_memmove)(void *, const void *, size_t) = memmove;
+static void *(*volatile libc_memset)(void *, int, size_t) = memset;
+
+static void copy_libc(void *d, const void *s, size_t n) { libc_memcpy(d, s, n); }
+static void move_libc(void *d, const void *s, size_t n) { libc_memmove(d, s, n); }
+
+typedef uint8_t v16 __attribute__((vector_size(16)));
+
+static inline v16 load16(const uint8_t *p) { v16 v; memcpy(&v, p, 16); return v; }
+static inline void store16(uint8_t *p, v16 v) { memcpy(p, &v, 16); }
+
+// 小于 16 B 的尾部：按 8 / 4 / 2 / 1 拷贝
+static inline void copy_tail(uint8_t *d, const uint8_t *s, size_t n) {
+    if (n & 8) { uint64_t x; memcpy(&x, s, 8); memcpy(d, &x, 8); d += 8; s += 8; }
+    if (n & 4) { uint32_t x; memcpy(&x, s, 4); memcpy(d, &x, 4); d += 4; s += 4; }
+    if (n & 2) { uint16_t x; memcpy(&x, s, 2); memcpy(d, &x, 2); d += 2; s += 2; }
+    if (n & 1) *d = *s;
+}
+
+static void copy_simd16(void *dst, const void *src, size_t n) {
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    if (n < 16) {
+        copy_tail(d, s, n);
+        return;
+    }
+    // 最后 16 B 先读出来，循环结束后用一次重叠写收尾
+    v16 last = load16(s + n - 16);
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        v16 a = load16(s + i), b = load16(s + i + 16), c = load16(s + i + 32), e = load16(s + i + 48);
+        store16(d + i, a); store16(d + i + 16, b); store16(d + i + 32, c); store16(d + i + 48, e);
+    }
+    for (; i + 16 <= n; i += 16) store16(d + i, load16(s + i));
+    store16(d + n - 16, last);
+}
+
+static void set_simd16(void *dst, int c, size_t n) {
+    uint8_t *d = dst;
+    if (n < 16) {
+        for (size_t i = 0; i < n; i++) d[i] = (uint8_t)c;
+        return;
+    }
+    v16 v = (v16){ 0 } + (uint8_t)c;
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        store16(d + i, v); store16(d + i + 16, v); store16(d + i + 32, v); store16(d + i + 48, v);
+    }
+    for (; i + 16 <= n; i += 16) store16(d + i, v);
+    store16(d + n - 16, v);
+}
+
+#if defined(__x86_64__)
+static void copy_rep_movsb(void *d, const void *s, size_t n) {
+    __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+}
+
+static void set_rep_stosb(void *d, int c, size_t n) {
+    __asm__ volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(c) : "memory");
+}
+
+__attribute__((target("avx2")))
+static void copy_avx2(void *dst, const void *src, size_t n) {
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    if (n < 32) {
+        copy_simd16(d, s, n);
+        return;
+    }
+    __m256i last = _mm256_loadu_si256((const __m256i *)(s + n - 32));
+    size_t i = 0;
+    for (; i + 128 <= n; i += 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s + i + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(s + i + 64));
+        __m256i e = _mm256_loadu_si256((const __m256i *)(s + i + 96));
+        _mm256_storeu_si256((__m256i *)(d + i), a);
+        _mm256_storeu_si256((__m256i *)(d + i + 32), b);
+        _mm256_storeu_si256((__m256i *)(d + i + 64), c);
+        _mm256_storeu_si256((__m256i *)(d + i + 96), e);
+    }
+    for (; i + 32 <= n; i += 32)
+        _mm256_storeu_si256((__m256i *)(d + i), _mm256_loadu_si256((const __m256i *)(s + i)));
+    _mm256_storeu_si256((__m256i *)(d + n - 32), last);
+}
+
+// 非临时拷贝：先用一次非对齐写补齐到 16 B 对齐，主循环 movntdq，最后 sfence
+static void copy_nt(void *dst, const void *src, size_t n) {
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    if (n < 64) {
+        copy_simd16(d, s, n);
+        return;
+    }
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    store16(d, load16(s));
+    d += head; s += head; n -= head;
+    v16 last = load16(s + n - 16);
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(s + i + 32));
+        __m128i e = _mm_loadu_si128((const __m128i *)(s + i + 48));
+        _mm_stream_si128((__m128i *)(d + i), a);
+        _mm_stream_si128((__m128i *)(d + i + 16), b);
+        _mm_stream_si128((__m128i *)(d + i + 32), c);
+        _mm_stream_si128((__m128i *)(d + i + 48), e);
+    }
+    for (; i + 16 <= n; i += 16)
+        _mm_stream_si128((__m128i *)(d + i), _mm_loadu_si128((const __m128i *)(s + i)));
+    _mm_sfence();
+    store16(d + n - 16, last);
+}
+
+static void set_nt(void *dst, int c, size_t n) {
+    uint8_t *d = dst;
+    if (n < 64) {
+        set_simd16(d, c, n);
+        return;
+    }
+    __m128i v = _mm_set1_epi8((char)c);
+    _mm_storeu_si128((__m128i *)d, v);
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    d += head; n -= head;
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        _mm_stream_si128((__m128i *)(d + i), v);
+        _mm_stream_si128((__m128i *)(d + i + 16), v);
+        _mm_stream_si128((__m128i *)(d + i + 32), v);
+        _mm_stream_si128((__m128i *)(d + i + 48), v);
+    }
+    for (; i + 16 <= n; i += 16) _mm_stream_si128((__m128i *)(d + i), v);
+    _mm_sfence();
+    _mm_storeu_si128((__m128i *)(d + n - 16), v);
+}
+
+#elif defined(__aarch64__)
+// arm64：stnp 是非临时的 store pair 提示
+static void copy_nt(void *dst, const void *src, size_t n) {
+    uint8_t *d = dst;
+    const uint8_t *s = src;
+    if (n < 64) {
+        copy_simd16(d, s, n);
+        return;
+    }
+    v16 last = load16(s + n - 16);
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __asm__ volatile("ldp q0, q1, [%0]\n\t"
+                         "ldp q2, q3, [%0, #32]\n\t"
+                         "stnp q0, q1, [%1]\n\t"
+                         "stnp q2, q3, [%1, #32]\n\t"
+                         : : "r"(s + i), "r"(d + i) : "v0", "v1", "v2", "v3", "memory");
+    }
+    for (; i + 16 <= n; i += 16) store16(d + i, load16(s + i));
+    store16(d + n - 16, last);
+}
+
+static void set_nt(void *dst, int c, size_t n) {
+    uint8_t *d = dst;
+    if (n < 64) {
+        set_simd16(d, c, n);
+        return;
+    }
+    v16 v = (v16){ 0 } + (uint8_t)c;
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __asm__ volatile("stnp %q2, %q2, [%0]\n\t"
+                         "stnp %q2, %q2, [%1]\n\t"
+                         : : "r"(d + i), "r"(d + i + 32), "w"(v) : "memory");
+    }
+    for (; i + 16 <= n; i += 16) store16(d + i, v);
+    store16(d + n - 16, v);
+}
+#endif
+
+static void set_libc(void *d, int c, size_t n) { libc_memset(d, c, n); }
+
+typedef struct {
+    const char *name;
+    copy_fn     fn;
+    int         enabled;
+} copy_impl;
+
+typedef struct {
+    const char *name;
+    set_fn      fn;
+    int         enabled;
+} set_impl;
+
+static copy_impl copies[] = {
+    { "libc",   copy_libc,      1 },
+#if defined(__x86_64__)
+    { "movsb",  copy_rep_movsb, 1 },
+#endif
+    { "simd16", copy_simd16,    1 },
+#if defined(__x86_64__)
+    { "avx2",   copy_avx2,      1 },
+#endif
+#if defined(__x86_64__) || defined(__aarch64__)
+    { "nt",     copy_nt,        1 },
+#endif
+};
+#define NUM_COPIES (sizeof(copies) / sizeof(copies[0]))
+
+static set_impl sets[] = {
+    { "libc",   set_libc,      1 },
+#if defined(__x86_64__)
+    { "stosb",  set_rep_stosb, 1 },
+#endif
+    { "simd16", set_simd16,    1 },
+#if defined(__x86_64__) || defined(__aarch64__)
+    { "nt",     set_nt,        1 },
+#endif
+};
+#define NUM_SETS (sizeof(sets) / sizeof(sets[0]))
+
+/*
+   -------- 计时 --------
+*/
+static size_t calls_for(size_t n) {
+    size_t calls = (size_t)(TARGET_BYTES / n);
+    if (calls < 1) calls = 1;
+    if (calls > MAX_CALLS) calls = MAX_CALLS;
+    return calls;
+}
+
+static int repeats_for(size_t n) { return n >= (256u << 20) ? 3 : 5; }
+
+static double copy_ns(copy_fn fn, uint8_t *dst, const uint8_t *src, size_t n) {
+    size_t calls = calls_for(n);
+    int rep = repeats_for(n);
+    double samples[5];
+    fn(dst, src, n);
+    for (int r = 0; r < rep; r++) {
+        uint64_t t0 = now_ns();
+        for (size_t i = 0; i < calls; i++) fn(dst, src, n);
+        uint64_t t1 = now_ns();
+        samples[r] = (double)(t1 - t0) / (double)calls;
+    }
+    return median(samples, (size_t)rep);
+}
+
+static double set_ns(set_fn fn, uint8_t *dst, size_t n) {
+    size_t calls = calls_for(n);
+    int rep = repeats_for(n);
+    double samples[5];
+    fn(dst, 0x5a, n);
+    for (int r = 0; r < rep; r++) {
+        uint64_t t0 = now_ns();
+        for (size_t i = 0; i < calls; i++) fn(dst, (int)i, n);
+        uint64_t t1 = now_ns();
+        samples[r] = (double)(t1 - t0) / (double)calls;
+    }
+    return median(samples, (size_t)rep);
+}
+
+static void format_size(char *buf, size_t len, size_t n) {
+    if (n >= (1u << 30))      snprintf(buf, len, "%zu GiB", n >> 30);
+    else if (n >= (1u << 20)) snprintf(buf, len, "%zu MiB", n >> 20);
+    else if (n >= (1u << 10)) snprintf(buf, len, "%zu KiB", n >> 10);
+    else                      snprintf(buf, len, "%zu B", n);
+}
+
+#define NUM_SIZES 31        // 1 B .. 1 GiB
+
+// 打印结果表（GB/s 与 cycles/call），并按大小区间列出最优实现
+static void print_sweep(const char *title, const char **names, size_t nimpl, double ns[][8]) {
+    char sz[32];
+    printf("%s: GB/s\n  %8s", title, "Size");
+    for (size_t k = 0; k < nimpl; k++) printf(" %9s", names[k]);
+    printf("\n  --------");
+    for (size_t k = 0; k < nimpl; k++) printf("----------");
+    printf("\n");
+    for (int i = 0; i < NUM_SIZES; i++) {
+        size_t n = (size_t)1 << i;
+        format_size(sz, sizeof(sz), n);
+        printf("  %8s", sz);
+        for (size_t k = 0; k < nimpl; k++) printf(" %9.2f", (double)n / ns[i][k]);
+        printf("\n");
+    }
+
+    printf("\n%s: cycles per call\n  %8s", title, "Size");
+    for (size_t k = 0; k < nimpl; k++) printf(" %9s", names[k]);
+    printf("\n  --------");
+    for (size_t k = 0; k < nimpl; k++) printf("----------");
+    printf("\n");
+    for (int i = 0; i < NUM_SIZES; i++) {
+        format_size(sz, sizeof(sz), (size_t)1 << i);
+        printf("  %8s", sz);
+        for (size_t k = 0; k < nimpl; k++) printf(" %9.0f", ns[i][k] * FREQ_GHZ);
+        printf("\n");
+    }
+
+    // 分界点：相邻大小的最优实现发生变化的位置
+    printf("\n%s: fastest implementation by size range\n", title);
+    int start = 0;
+    for (int i = 0; i <= NUM_SIZES; i++) {
+        size_t best_prev = 0, best_cur = 0;
+        for (size_t k = 1; k < nimpl; k++) {
+            if (ns[start][k] < ns[start][best_prev]) best_prev = k;
+            if (i < NUM_SIZES && ns[i][k] < ns[i][best_cur]) best_cur = k;
+        }
+        if (i == NUM_SIZES || best_cur != best_prev) {
+            char a[32], b[32];
+            format_size(a, sizeof(a), (size_t)1 << start);
+            format_size(b, sizeof(b), (size_t)1 << (i - 1));
+            printf("  %8s .. %-8s : %s\n", a, b, names[best_prev]);
+            start = i;
+        }
+    }
+    printf("\n");
+}
+
+int main(void) {
+    printf("[27] memcpy / memset / memmove Characterization\n");
+    printf("Assumed CPU freq = %.2f GHz; sizes 1 B .. 1 GiB, buffers reused (small sizes are cache-hot)\n",
+           FREQ_GHZ);
+    printf("NOTE: nt stores evict the destination from cache, so nt is expected to lose while the data fits in cache.\n");
+#if defined(__x86_64__)
+    if (!__builtin_cpu_supports("avx2")) {
+        for (size_t k = 0; k < NUM_COPIES; k++)
+            if (strcmp(copies[k].name, "avx2") == 0) copies[k].enabled = 0;
+        printf("NOTE: AVX2 not available, avx2 copy skipped.\n");
+    }
+#else
+    printf("NOTE: rep movsb / rep stosb are x86-only; skipped.\n");
+#endif
+    printf("\n");
+
+    // 两块 1 GiB + 8 KiB 的缓冲区，预先写一遍避免缺页混入测量
+    uint8_t *src = aligned_alloc(4096, MAX_BYTES + 8192);
+    uint8_t *dst = aligned_alloc(4096, MAX_BYTES + 8192);
+    if (!src || !dst) {
+        fprintf(stderr, "allocation failed (needs ~2 GiB)\n");
+        return 1;
+    }
+    memset(src, 1, MAX_BYTES + 8192);
+    memset(dst, 2, MAX_BYTES + 8192);
+
+    // A) copy 扫描
+    const char *cnames[8];
+    size_t nc = 0;
+    copy_fn cfns[8];
+    for (size_t k = 0; k < NUM_COPIES; k++)
+        if (copies[k].enabled) { cnames[nc] = copies[k].name; cfns[nc] = copies[k].fn; nc++; }
+    static double cns[NUM_SIZES][8];
+    for (int i = 0; i < NUM_SIZES; i++)
+        for (size_t k = 0; k < nc; k++)
+            cns[i][k] = copy_ns(cfns[k], dst, src, (size_t)1 << i);
+    print_sweep("A) copy", cnames, nc, cns);
+    fflush(stdout);
+
+    // B) memset 扫描
+    const char *snames[8];
+    set_fn sfns[8];
+    size_t ns_ = 0;
+    for (size_t k = 0; k < NUM_SETS; k++)
+        if (sets[k].enabled) { snames[ns_] = sets[k].name; sfns[ns_] = sets[k].fn; ns_++; }
+    static double sns[NUM_SIZES][8];
+    for (int i = 0; i < NUM_SIZES; i++)
+        for (size_t k = 0; k < ns_; k++)
+            sns[i][k] = set_ns(sfns[k], dst, (size_t)1 << i);
+    print_sweep("B) memset", snames, ns_, sns);
+    fflush(stdout);
+
+    // C) 对齐：src / dst 相对页起点的偏移
+    static const size_t align_sizes[] = { 64, 4096, 1u << 20 };
+    static const struct { size_t s, d; } offs[] = {
+        { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 }, { 8, 0 }, { 0, 8 }, { 16, 16 }, { 32, 0 }, { 63, 1 },
+    };
+    printf("C) Alignment: copy GB/s with src/dst offsets from a 4 KiB boundary\n");
+    printf("  %8s %5s %5s", "Size", "src+", "dst+");
+    for (size_t k = 0; k < nc; k++) printf(" %9s", cnames[k]);
+    printf("\n  --------------------");
+    for (size_t k = 0; k < nc; k++) printf("----------");
+    printf("\n");
+    for (size_t a = 0; a < sizeof(align_sizes) / sizeof(align_sizes[0]); a++) {
+        char sz[32];
+        format_size(sz, sizeof(sz), align_sizes[a]);
+        for (size_t o = 0; o < sizeof(offs) / sizeof(offs[0]); o++) {
+            printf("  %8s %5zu %5zu", sz, offs[o].s, offs[o].d);
+            for (size_t k = 0; k < nc; k++) {
+                double ns = copy_ns(cfns[k], dst + offs[o].d, src + offs[o].s, align_sizes[a]);
+                printf(" %9.2f", (double)align_sizes[a] / ns);
+            }
+            printf("\n");
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+
+    // D) 重叠：dst = src +/- dist，在同一块缓冲区里 memmove
+    static const size_t ov_sizes[] = { 4096, 1u << 20, 64u << 20 };
+    static const size_t dists[] = { 1, 8, 64, 4096 };
+    printf("D) Overlap: memmove GB/s within one buffer vs non-overlapping memcpy\n");
+    printf("(memmove works within one buffer, so its footprint is about half of memcpy's at large sizes)\n");
+    printf("  %8s %6s %12s %12s %12s\n", "Size", "dist", "fwd (d>s)", "bwd (d<s)", "memcpy");
+    printf("  ------------------------------------------------------------\n");
+    for (size_t a = 0; a < sizeof(ov_sizes) / sizeof(ov_sizes[0]); a++) {
+        char sz[32];
+        size_t n = ov_sizes[a];
+        format_size(sz, sizeof(sz), n);
+        double base = copy_ns(copy_libc, dst, src, n);
+        for (size_t k = 0; k < sizeof(dists) / sizeof(dists[0]); k++) {
+            uint8_t *mid = src + 4096;
+            double fwd = copy_ns(move_libc, mid + dists[k], mid, n);
+            double bwd = copy_ns(move_libc, mid - dists[k], mid, n);
+            printf("  %8s %6zu %12.2f %12.2f %12.2f\n", sz, dists[k],
+                   (double)n / fwd, (double)n / bwd, (double)n / base);
+        }
+    }
+    printf("\n");
+
+    free(src);
+    free(dst);
+    return 0;
+}
@@ -0,0 +1,247 @@
+// 028_gups.c
+// 实验目的：测随机读-改-写的吞吐（GUPS, giga updates per second），对应 hash join / 计数类负载；
+//   08 / 010 只测顺序带宽，看不到随机访问下每次只用到 cache line 中 8 B 的代价
+// 方法：HPCC RandomAccess 的做法：64 位 LFSR 生成随机数 r，table[r & (N-1)] ^= r
+//   plain    ：逐个更新，靠乱序执行自行重叠 miss
+//   prefetch ：先算出后 PF_DIST 个下标并发出写预取，再执行更新（批量 + 软件预取）
+//   A) 单线程，表大小从 L1 级 (16 KiB) 扫到数 GiB
+//   B) 多线程（1..N，线程 i 绑 cpu i），共享同一张表，几个代表性大小；与 HPCC 一致，并发更新不加锁
+// 报告：Mupd/s、ns/upd，有效带宽按每次更新 16 B（读 8 B + 写 8 B）计，line 带宽按读写各一整行 (128 B) 计
+// 大表在 Linux 上 madvise(MADV_HUGEPAGE)，减少 TLB miss 的干扰
+// 用法：./bin/028_gups [最大表大小 GiB, 默认 4，另受物理内存一半限制]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+  #include <sys/mman.h>
+#endif
+#include "harness.h"
+
+#define REPEAT       3
+#define WINDOW_MS    200
+#define MAX_THREADS  256
+#define POLY         0x0000000000000007ull      // HPCC 使用的 LFSR 多项式
+#define CHUNK        1024                       // 每检查一次 stop 之间的更新数
+#define PF_DIST      32                         // 预取距离（更新数）
+#define MIN_BYTES    (16u << 10)
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+static inline uint64_t lfsr_next(uint64_t r) {
+    return (r << 1) ^ ((int64_t)r < 0 ? POLY : 0);
+}
+
+typedef struct {
+    int           cpu;
+    int           prefetch;
+    uint64_t     *table;
+    uint64_t      mask;             // 表项数 - 1
+    uint64_t      seed;
+    volatile int *start;
+    volatile int *stop;
+    uint64_t      updates;          // 结果
+} thread_arg;
+
+static size_t update_plain(uint64_t *t, uint64_t mask, uint64_t *ran, size_t n) {
+    uint64_t r = *ran;
+    for (size_t i = 0; i < n; i++) {
+        r = lfsr_next(r);
+        t[r & mask] ^= r;
+    }
+    *ran = r;
+    return n;
+}
+
+// 随机数序列提前 PF_DIST 步生成：ring 里存着已预取、待更新的值
+static size_t update_prefetch(uint64_t *t, uint64_t mask, uint64_t *ring, size_t *pos, uint64_t *ran, size_t n) {
+    uint64_t r = *ran;
+    size_t p = *pos;
+    for (size_t i = 0; i < n; i++) {
+        r = lfsr_next(r);
+        __builtin_prefetch(&t[r & mask], 1, 0);
+        uint64_t v = ring[p];
+        ring[p] = r;
+        p = (p + 1) & (PF_DIST - 1);
+        t[v & mask] ^= v;
+    }
+    *ran = r;
+    *pos = p;
+    return n;
+}
+
+static void *run_gups(void *arg) {
+    thread_arg *a = arg;
+    pin_thread_to_cpu(a->cpu);
+
+    uint64_t ran = a->seed, ring[PF_DIST];
+    size_t pos = 0;
+    // 预填 ring：开头的 PF_DIST 个值先预取，进入主循环后再更新
+    for (int i = 0; i < PF_DIST; i++) {
+        ran = lfsr_next(ran);
+        ring[i] = ran;
+        __builtin_prefetch(&a->table[ran & a->mask], 1, 0);
+    }
+    uint64_t done = 0;
+    while (!*a->start) { /* spin */ }
+    while (!*a->stop) {
+        if (a->prefetch) done += update_prefetch(a->table, a->mask, ring, &pos, &ran, CHUNK);
+        else             done += update_plain(a->table, a->mask, &ran, CHUNK);
+    }
+    a->updates = done;
+    return NULL;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static int thread_counts(int max, int *out) {
+    int n = 0;
+    for (int t = 1; t < max; t *= 2) out[n++] = t;
+    out[n++] = max;
+    return n;
+}
+
+// n 个线程在表上跑 WINDOW_MS，返回总更新率（updates / ns），REPEAT 次取中位数
+static double measure(uint64_t *table, uint64_t entries, int n, int ncpu, int prefetch) {
+    thread_arg args[MAX_THREADS];
+    pthread_t th[MAX_THREADS];
+    double samples[REPEAT];
+    for (int r = 0; r < REPEAT; r++) {
+        volatile int start = 0, stop = 0;
+        for (int i = 0; i < n; i++) {
+            args[i] = (thread_arg){ .cpu = i % ncpu, .prefetch = prefetch, .table = table,
+                                    .mask = entries - 1, .start = &start, .stop = &stop,
+                                    .seed = 0x9e3779b97f4a7c15ull * (uint64_t)(i + 1 + r * MAX_THREADS) };
+            pthread_create(&th[i], NULL, run_gups, &args[i]);
+        }
+        uint64_t t0 = now_ns();
+        start = 1;
+        sleep_ms(WINDOW_MS);
+        stop = 1;
+        uint64_t total = 0;
+        for (int i = 0; i < n; i++) {
+            pthread_join(th[i], NULL);
+            total += args[i].updates;
+        }
+        uint64_t t1 = now_ns();
+        samples[r] = (double)total / (double)(t1 - t0);
+    }
+    return median(samples, REPEAT);
+}
+
+static void format_size(char *buf, size_t len, uint64_t n) {
+    if (n >= (1ull << 30))      snprintf(buf, len, "%llu GiB", (unsigned long long)(n >> 30));
+    else if (n >= (1ull << 20)) snprintf(buf, len, "%llu MiB", (unsigned long long)(n >> 20));
+    else                        snprintf(buf, len, "%llu KiB", (unsigned long long)(n >> 10));
+}
+
+// HPCC 式校验：同一随机序列再做一遍，XOR 抵消后表应回到初值
+static uint64_t verify(uint64_t *table, uint64_t entries) {
+    for (int pass = 0; pass < 2; pass++) {
+        uint64_t ran = 1;
+        update_plain(table, entries - 1, &ran, 4 * entries);
+    }
+    uint64_t errors = 0;
+    for (uint64_t i = 0; i < entries; i++)
+        if (table[i] != i) errors++;
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    int ncpu = num_online_cpus();
+    double max_gib = argc > 1 ? atof(argv[1]) : 4.0;
+    if (max_gib <= 0) max_gib = 4.0;
+
+    uint64_t max_bytes = (uint64_t)(max_gib * (double)(1ull << 30));
+    long pages = sysconf(_SC_PHYS_PAGES), psz = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && psz > 0 && max_bytes > (uint64_t)pages * (uint64_t)psz / 2)
+        max_bytes = (uint64_t)pages * (uint64_t)psz / 2;
+    uint64_t top = MIN_BYTES;
+    while (top * 2 <= max_bytes) top *= 2;
+
+    printf("[28] Random-Access Update Throughput (GUPS)\n");
+    printf("Online CPUs: %d, largest table: ", ncpu);
+    char sz[32];
+    format_size(sz, sizeof(sz), top);
+    printf("%s, prefetch distance: %d updates\n", sz, PF_DIST);
+    if (pin_thread_to_cpu(0) != 0)
+        printf("NOTE: thread pinning unavailable on this platform; threads float.\n");
+
+    uint64_t *table = aligned_alloc(4096, top);
+    if (!table) {
+        fprintf(stderr, "allocation failed (%llu bytes)\n", (unsigned long long)top);
+        return 1;
+    }
+#if defined(MADV_HUGEPAGE)
+    // 大表的随机访问会被 4 KiB 页的 TLB miss 主导；有 THP 时尽量用 2 MiB 页，让结果更接近 cache / DRAM 本身
+    if (madvise(table, top, MADV_HUGEPAGE) == 0)
+        printf("Table backed by transparent huge pages where available (MADV_HUGEPAGE)\n");
+#endif
+    for (uint64_t i = 0; i < top / 8; i++) table[i] = i;
+
+    uint64_t check = top < (1u << 20) ? top : (1u << 20);
+    uint64_t errors = verify(table, check / 8);
+    printf("Verification (%llu KiB table, update sequence applied twice): %llu errors\n\n",
+           (unsigned long long)(check >> 10), (unsigned long long)errors);
+
+    // A) 单线程大小扫描
+    printf("A) Single thread, table size sweep\n");
+    printf("  %8s | %9s %8s %9s %9s | %9s %8s %9s %8s\n", "Table",
+           "Mupd/s", "ns/upd", "eff GB/s", "line GB/s", "pf Mupd/s", "ns/upd", "eff GB/s", "speedup");
+    printf("  -----------------------------------------------------------------------------------------------\n");
+    for (uint64_t bytes = MIN_BYTES; bytes <= top; bytes *= 2) {
+        double plain = measure(table, bytes / 8, 1, ncpu, 0);
+        double pf    = measure(table, bytes / 8, 1, ncpu, 1);
+        format_size(sz, sizeof(sz), bytes);
+        printf("  %8s | %9.1f %8.2f %9.2f %9.2f | %9.1f %8.2f %9.2f %7.2fx\n", sz,
+               plain * 1e3, 1.0 / plain, plain * 16.0, plain * 128.0,
+               pf * 1e3, 1.0 / pf, pf * 16.0, pf / plain);
+        fflush(stdout);
+    }
+    printf("(eff = 16 useful B per update; line = a full 64 B line read + written per update,\n"
+           " only meaningful once the table no longer fits in cache)\n\n");
+
+    // B) 多线程扩展：cache 内、LLC 级、DRAM 级三种大小
+    uint64_t picks[3] = { 256u << 10, 32u << 20, top };
+    int counts[32];
+    int max_threads = ncpu < MAX_THREADS ? ncpu : MAX_THREADS;
+    int num_counts = thread_counts(max_threads, counts);
+    printf("B) Thread scaling on one shared table (thread i on cpu i; unsynchronized updates as in HPCC)\n");
+    printf("  %8s %7s | %12s %9s | %12s %9s\n", "Table", "Threads", "GUPS", "eff GB/s", "pf GUPS", "eff GB/s");
+    printf("  ----------------------------------------------------------------\n");
+    for (int p = 0; p < 3; p++) {
+        if (picks[p] > top || (p > 0 && picks[p] == picks[p - 1])) continue;
+        format_size(sz, sizeof(sz), picks[p]);
+        for (int c = 0; c < num_counts; c++) {
+            double plain = measure(table, picks[p] / 8, counts[c], ncpu, 0);
+            double pf    = measure(table, picks[p] / 8, counts[c], ncpu, 1);
+            printf("  %8s %7d | %12.4f %9.2f | %12.4f %9.2f\n", sz, counts[c],
+                   plain, plain * 16.0, pf, pf * 16.0);
+            fflush(stdout);
+        }
+    }
+    printf("\n");
+
+    free(table);
+    return 0;
+}
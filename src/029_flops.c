@@ -0,0 +1,359 @@
+// 029_flops.c
+// 实验目的：测浮点 add / mul / FMA 的峰值吞吐（单 / 双精度，标量与各 SIMD 宽度，单核与全核），
+//   并结合各级 cache / DRAM 带宽给出 roofline（可达 GFLOP/s 与算术强度的关系）
+// 方法：
+//   每个 kernel 有 NACC 条相互独立的累加链，链数 >= 延迟 * 每周期发射数，才能压满 FP 单元；
+//   x86 256 位及以下只有 16 个向量寄存器，用 12 条链；AVX-512 / arm64 有 32 个寄存器，用 16 条
+//   宽度：scalar、128 (SSE / NEON)、256 (AVX2+FMA)、512 (AVX-512F)，x86 上运行时检测
+//   A) 单核：GFLOP/s 与 flop/cycle（按假定主频）
+//   B) 全核：每个 CPU 绑一个线程跑同一 kernel，总 GFLOP/s
+//   C) roofline：读带宽用与 08 / 010 相同的 8 路独立 64 位 load 循环，工作集取 harness 检测到的各级 cache 容量的一半
+//      和 010 的 512 MiB；峰值取单核 FMA 的最快宽度。输出 ridge point 与各算术强度下的可达性能
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "harness.h"
+
+#if defined(__x86_64__)
+  #include <immintrin.h>
+#elif defined(__aarch64__)
+  #include <arm_neon.h>
+#endif
+
+#define REPEAT       5
+#define FREQ_GHZ     3.2
+#define MAX_THREADS  256
+#define ITERS        (1u << 22)                 // 每次调用的循环次数，每次迭代每条链一个操作
+#define BW_TARGET    (512ull << 20)             // 带宽测量每次大约读取的字节数
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+static volatile double flop_sink;
+
+/*
+   -------- kernel 生成 --------
+   OP(x) 是对一条链的一步更新；常数让值保持在正常数范围内（不会溢出也不会进入 subnormal）：
+     add: x = x + c            mul: x = x * m (m 略小于 1)            fma: x = x * m + c
+   各链初值不同，否则编译器会把相同的链合并成一条；
+   链数 NACC 为编译期常量，多出来的链是死代码，会被编译器删除
+*/
+#define CHAINS(OP, BAR)                                                     \
+    x0 = OP(x0); x1 = OP(x1); x2 = OP(x2); x3 = OP(x3);                     \
+    x4 = OP(x4); x5 = OP(x5); x6 = OP(x6); x7 = OP(x7);                     \
+    x8 = OP(x8); x9 = OP(x9); x10 = OP(x10); x11 = OP(x11);                 \
+    if (NACC > 12) { x12 = OP(x12); x13 = OP(x13); x14 = OP(x14); x15 = OP(x15); } \
+    BAR(x0); BAR(x1); BAR(x2); BAR(x3); BAR(x4); BAR(x5); BAR(x6); BAR(x7); \
+    BAR(x8); BAR(x9); BAR(x10); BAR(x11);                                   \
+    if (NACC > 12) { BAR(x12); BAR(x13); BAR(x14); BAR(x15); }
+
+#define DEF_KERNEL(name, ATTR, T, ELEM, SET1, ADD, OP, BAR, NACC_)          \
+    ATTR static void name(size_t iters) {                                   \
+        enum { NACC = NACC_ };                                              \
+        const T m = SET1((ELEM)0.9999999), c = SET1((ELEM)1e-7);            \
+        T x0 = SET1((ELEM)1.00), x1 = SET1((ELEM)1.01), x2 = SET1((ELEM)1.02);  \
+        T x3 = SET1((ELEM)1.03), x4 = SET1((ELEM)1.04), x5 = SET1((ELEM)1.05);  \
+        T x6 = SET1((ELEM)1.06), x7 = SET1((ELEM)1.07), x8 = SET1((ELEM)1.08);  \
+        T x9 = SET1((ELEM)1.09), x10 = SET1((ELEM)1.10), x11 = SET1((ELEM)1.11); \
+        T x12 = SET1((ELEM)1.12), x13 = SET1((ELEM)1.13), x14 = SET1((ELEM)1.14); \
+        T x15 = SET1((ELEM)1.15);                                           \
+        (void)m; (void)c;                                                   \
+        for (size_t i = 0; i < iters; i++) { CHAINS(OP, BAR) }              \
+        T s = ADD(ADD(ADD(x0, x1), ADD(x2, x3)), ADD(ADD(x4, x5), ADD(x6, x7))); \
+        s = ADD(s, ADD(ADD(ADD(x8, x9), x10), x11));                        \
+        s = ADD(s, ADD(ADD(x12, x13), ADD(x14, x15)));                      \
+        ELEM out;                                                           \
+        memcpy(&out, &s, sizeof(out));                                      \
+        flop_sink = (double)out;                                            \
+    }
+
+// 一个宽度 / 精度生成 add、mul、fma 三个 kernel
+#define DEF_KERNELS(sfx, ATTR, T, ELEM, SET1, ADD, BAR, NACC_)                  \
+    DEF_KERNEL(k_add_##sfx, ATTR, T, ELEM, SET1, ADD, OP_ADD_##sfx, BAR, NACC_)  \
+    DEF_KERNEL(k_mul_##sfx, ATTR, T, ELEM, SET1, ADD, OP_MUL_##sfx, BAR, NACC_)  \
+    DEF_KERNEL(k_fma_##sfx, ATTR, T, ELEM, SET1, ADD, OP_FMA_##sfx, BAR, NACC_)
+
+#define NO_BAR(x) ((void)0)
+
+#define SCALAR_SET1(v) (v)
+#define SCALAR_ADD(a, b) ((a) + (b))
+
+// 标量：fma 用 __builtin_fma，目标支持 FMA 时会内联成单条指令
+// 标量链之间加空 asm 屏障，防止编译器把 12 条独立标量链 SLP 向量化
+#if defined(__x86_64__)
+  #define SCALAR_ATTR __attribute__((target("fma")))
+  #define SCALAR_BAR(x) __asm__("" : "+x"(x))
+#elif defined(__aarch64__)
+  #define SCALAR_ATTR
+  #define SCALAR_BAR(x) __asm__("" : "+w"(x))
+#else
+  #define SCALAR_ATTR
+  #define SCALAR_BAR(x) ((void)0)
+#endif
+#define OP_ADD_s1(x) ((x) + c)
+#define OP_MUL_s1(x) ((x) * m)
+#define OP_FMA_s1(x) __builtin_fmaf((x), m, c)
+#define OP_ADD_d1(x) ((x) + c)
+#define OP_MUL_d1(x) ((x) * m)
+#define OP_FMA_d1(x) __builtin_fma((x), m, c)
+DEF_KERNELS(s1, SCALAR_ATTR, float,  float,  SCALAR_SET1, SCALAR_ADD, SCALAR_BAR, 12)
+DEF_KERNELS(d1, SCALAR_ATTR, double, double, SCALAR_SET1, SCALAR_ADD, SCALAR_BAR, 12)
+
+#if defined(__x86_64__)
+  #define OP_ADD_s4(x) _mm_add_ps((x), c)
+  #define OP_MUL_s4(x) _mm_mul_ps((x), m)
+  #define OP_FMA_s4(x) _mm_fmadd_ps((x), m, c)
+  #define OP_ADD_d2(x) _mm_add_pd((x), c)
+  #define OP_MUL_d2(x) _mm_mul_pd((x), m)
+  #define OP_FMA_d2(x) _mm_fmadd_pd((x), m, c)
+  DEF_KERNELS(s4, __attribute__((target("fma"))), __m128, float, _mm_set1_ps, _mm_add_ps, NO_BAR, 12)
+  DEF_KERNELS(d2, __attribute__((target("fma"))), __m128d, double, _mm_set1_pd, _mm_add_pd, NO_BAR, 12)
+
+  #define OP_ADD_s8(x) _mm256_add_ps((x), c)
+  #define OP_MUL_s8(x) _mm256_mul_ps((x), m)
+  #define OP_FMA_s8(x) _mm256_fmadd_ps((x), m, c)
+  #define OP_ADD_d4(x) _mm256_add_pd((x), c)
+  #define OP_MUL_d4(x) _mm256_mul_pd((x), m)
+  #define OP_FMA_d4(x) _mm256_fmadd_pd((x), m, c)
+  DEF_KERNELS(s8, __attribute__((target("avx2,fma"))), __m256, float, _mm256_set1_ps, _mm256_add_ps, NO_BAR, 12)
+  DEF_KERNELS(d4, __attribute__((target("avx2,fma"))), __m256d, double, _mm256_set1_pd, _mm256_add_pd, NO_BAR, 12)
+
+  #define OP_ADD_s16(x) _mm512_add_ps((x), c)
+  #define OP_MUL_s16(x) _mm512_mul_ps((x), m)
+  #define OP_FMA_s16(x) _mm512_fmadd_ps((x), m, c)
+  #define OP_ADD_d8(x) _mm512_add_pd((x), c)
+  #define OP_MUL_d8(x) _mm512_mul_pd((x), m)
+  #define OP_FMA_d8(x) _mm512_fmadd_pd((x), m, c)
+  DEF_KERNELS(s16, __attribute__((target("avx512f"))), __m512, float, _mm512_set1_ps, _mm512_add_ps, NO_BAR, 16)
+  DEF_KERNELS(d8, __attribute__((target("avx512f"))), __m512d, double, _mm512_set1_pd, _mm512_add_pd, NO_BAR, 16)
+#elif defined(__aarch64__)
+  #define OP_ADD_s4(x) vaddq_f32((x), c)
+  #define OP_MUL_s4(x) vmulq_f32((x), m)
+  #define OP_FMA_s4(x) vfmaq_f32(c, (x), m)
+  #define OP_ADD_d2(x) vaddq_f64((x), c)
+  #define OP_MUL_d2(x) vmulq_f64((x), m)
+  #define OP_FMA_d2(x) vfmaq_f64(c, (x), m)
+  DEF_KERNELS(s4, , float32x4_t, float, vdupq_n_f32, vaddq_f32, NO_BAR, 16)
+  DEF_KERNELS(d2, , float64x2_t, double, vdupq_n_f64, vaddq_f64, NO_BAR, 16)
+#endif
+
+typedef void (*kernel_fn)(size_t iters);
+
+typedef struct {
+    const char *isa;        // 宽度 / 指令集标签
+    int         bits;
+    int         dp;         // 1 = double
+    int         lanes;
+    int         nacc;       // 独立链数，与 DEF_KERNELS 的最后一个参数一致
+    kernel_fn   add, mul, fma;
+    int         enabled;
+} kernel_set;
+
+static kernel_set kernels[] = {
+    { "scalar",  64, 0, 1, 12,  k_add_s1,  k_mul_s1,  k_fma_s1,  1 },
+    { "scalar",  64, 1, 1, 12,  k_add_d1,  k_mul_d1,  k_fma_d1,  1 },
+#if defined(__x86_64__)
+    { "SSE+FMA", 128, 0, 4, 12,  k_add_s4,  k_mul_s4,  k_fma_s4,  1 },
+    { "SSE+FMA", 128, 1, 2, 12,  k_add_d2,  k_mul_d2,  k_fma_d2,  1 },
+    { "AVX2",    256, 0, 8, 12,  k_add_s8,  k_mul_s8,  k_fma_s8,  1 },
+    { "AVX2",    256, 1, 4, 12,  k_add_d4,  k_mul_d4,  k_fma_d4,  1 },
+    { "AVX-512", 512, 0, 16, 16, k_add_s16, k_mul_s16, k_fma_s16, 1 },
+    { "AVX-512", 512, 1, 8, 16,  k_add_d8,  k_mul_d8,  k_fma_d8,  1 },
+#elif defined(__aarch64__)
+    { "NEON",    128, 0, 4, 16,  k_add_s4,  k_mul_s4,  k_fma_s4,  1 },
+    { "NEON",    128, 1, 2, 16,  k_add_d2,  k_mul_d2,  k_fma_d2,  1 },
+#endif
+};
+#define NUM_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+/*
+   -------- 计时 --------
+*/
+typedef struct {
+    int           cpu;
+    kernel_fn     fn;
+    atomic_int   *ready;    // 预热完成的线程数
+    volatile int *start;
+} thread_arg;
+
+static void *run_kernel(void *arg) {
+    thread_arg *a = arg;
+    pin_thread_to_cpu(a->cpu);
+    a->fn(ITERS / 16);          // 预热，让频率和 SIMD 单元进入稳态
+    atomic_fetch_add(a->ready, 1);
+    while (!*a->start) { /* spin */ }
+    a->fn(ITERS);
+    return NULL;
+}
+
+// n 个线程各跑一次 kernel，返回总 GFLOP/s；flops_per_iter 是单线程每次迭代的浮点运算数
+static double measure_gflops(kernel_fn fn, double flops_per_iter, int n, int ncpu) {
+    double samples[REPEAT];
+    for (int r = 0; r < REPEAT; r++) {
+        if (n == 1) {
+            fn(ITERS / 16);
+            uint64_t t0 = now_ns();
+            fn(ITERS);
+            uint64_t t1 = now_ns();
+            samples[r] = flops_per_iter * ITERS / (double)(t1 - t0);
+            continue;
+        }
+        thread_arg args[MAX_THREADS];
+        pthread_t th[MAX_THREADS];
+        atomic_int ready = 0;
+        volatile int start = 0;
+        for (int i = 0; i < n; i++) {
+            args[i] = (thread_arg){ .cpu = i % ncpu, .fn = fn, .ready = &ready, .start = &start };
+            pthread_create(&th[i], NULL, run_kernel, &args[i]);
+        }
+        // 等所有线程预热完再开始计时，否则 t0..t1 会把预热也算进去
+        while (atomic_load(&ready) < n) { /* spin */ }
+        uint64_t t0 = now_ns();
+        start = 1;
+        for (int i = 0; i < n; i++) pthread_join(th[i], NULL);
+        uint64_t t1 = now_ns();
+        samples[r] = flops_per_iter * ITERS * n / (double)(t1 - t0);
+    }
+    return median(samples, REPEAT);
+}
+
+// 与 08 / 010 相同的读带宽循环：8 路独立 64 位 load
+static double measure_read_bw(const uint64_t *p, size_t size_bytes) {
+    const size_t elems = size_bytes / sizeof(uint64_t);
+    size_t outer = BW_TARGET / size_bytes;
+    if (outer < 1) outer = 1;
+    double samples[REPEAT];
+    for (int r = 0; r < REPEAT; r++) {
+        volatile uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0, s4 = 0, s5 = 0, s6 = 0, s7 = 0;
+        uint64_t t0 = now_ns();
+        for (size_t o = 0; o < outer; o++) {
+            for (size_t i = 0; i + 8 <= elems; i += 8) {
+                s0 += p[i + 0]; s1 += p[i + 1]; s2 += p[i + 2]; s3 += p[i + 3];
+                s4 += p[i + 4]; s5 += p[i + 5]; s6 += p[i + 6]; s7 += p[i + 7];
+            }
+        }
+        uint64_t t1 = now_ns();
+        samples[r] = (double)size_bytes * (double)outer / (double)(t1 - t0);
+    }
+    return median(samples, REPEAT);
+}
+
+int main(void) {
+    int ncpu = num_online_cpus();
+    int nthreads = ncpu < MAX_THREADS ? ncpu : MAX_THREADS;
+
+    printf("[29] Floating-Point Peak Throughput and Roofline\n");
+    printf("Online CPUs: %d, assumed CPU freq = %.2f GHz, %u iterations per run\n", ncpu, FREQ_GHZ, ITERS);
+    if (pin_thread_to_cpu(0) != 0)
+        printf("NOTE: thread pinning unavailable on this platform; threads float.\n");
+#if defined(__x86_64__)
+    int has_fma = __builtin_cpu_supports("fma");
+    for (size_t k = 0; k < NUM_KERNELS; k++) {
+        if (kernels[k].bits == 512 && !__builtin_cpu_supports("avx512f")) kernels[k].enabled = 0;
+        if (kernels[k].bits == 256 && !__builtin_cpu_supports("avx2")) kernels[k].enabled = 0;
+        // 没有 FMA 时 128 位和标量 kernel 也带 target("fma")，不能运行
+        if (!has_fma) kernels[k].enabled = 0;
+    }
+    if (!has_fma) printf("NOTE: CPU lacks FMA; this benchmark's kernels are compiled for FMA-capable x86, all skipped.\n");
+    else if (!__builtin_cpu_supports("avx512f")) printf("NOTE: AVX-512F not available, 512-bit rows skipped.\n");
+#endif
+    printf("\n");
+
+    // A) / B)
+    double peak_fma[2] = { 0, 0 };          // 单核 FMA 最快宽度，[0] = SP, [1] = DP
+    const char *peak_isa[2] = { "-", "-" };
+    printf("A/B) Peak throughput (flop/cycle is per core at the assumed frequency; FMA counts 2 flops)\n");
+    printf("  %-8s %4s %4s | %10s %10s %10s | %9s %9s %9s | %12s\n", "ISA", "bits", "prec",
+           "add GF/s", "mul GF/s", "fma GF/s", "add f/c", "mul f/c", "fma f/c", "all-core FMA");
+    printf("  ------------------------------------------------------------------------------------------------------\n");
+    for (size_t k = 0; k < NUM_KERNELS; k++) {
+        kernel_set *ks = &kernels[k];
+        if (!ks->enabled) continue;
+        double per_iter = (double)(ks->nacc * ks->lanes);
+        double add = measure_gflops(ks->add, per_iter, 1, ncpu);
+        double mul = measure_gflops(ks->mul, per_iter, 1, ncpu);
+        double fma = measure_gflops(ks->fma, 2 * per_iter, 1, ncpu);
+        double all = measure_gflops(ks->fma, 2 * per_iter, nthreads, ncpu);
+        if (fma > peak_fma[ks->dp]) { peak_fma[ks->dp] = fma; peak_isa[ks->dp] = ks->isa; }
+        printf("  %-8s %4d %4s | %10.2f %10.2f %10.2f | %9.2f %9.2f %9.2f | %12.2f\n",
+               ks->isa, ks->bits, ks->dp ? "DP" : "SP", add, mul, fma,
+               add / FREQ_GHZ, mul / FREQ_GHZ, fma / FREQ_GHZ, all);
+        fflush(stdout);
+    }
+    printf("  (all-core FMA uses %d threads, thread i on cpu i)\n\n", nthreads);
+
+    // C) roofline：每级 cache 取容量的一半，DRAM 取最后一级的 4 倍（至少 512 MiB）
+    cpu_topology topo;
+    topology_detect(&topo);
+    struct { char name[8]; size_t bytes; } levels[TOPO_MAX_CACHES + 1];
+    int NUM_LEVELS = 0;
+    size_t last = 0;
+    for (int level = 1; level <= 4; level++) {
+        const cache_info *c = topology_cache(&topo, level, CACHE_DATA);
+        if (!c) continue;
+        snprintf(levels[NUM_LEVELS].name, sizeof(levels[0].name), "L%d", level);
+        levels[NUM_LEVELS++].bytes = (c->size / 2) & ~(size_t)63;
+        last = c->size;
+    }
+    snprintf(levels[NUM_LEVELS].name, sizeof(levels[0].name), "DRAM");
+    levels[NUM_LEVELS++].bytes = 4 * last > (512u << 20) ? 4 * last : (512u << 20);
+    uint64_t *buf = malloc(levels[NUM_LEVELS - 1].bytes);
+    if (!buf) {
+        fprintf(stderr, "allocation failed\n");
+        return 1;
+    }
+    memset(buf, 1, levels[NUM_LEVELS - 1].bytes);
+    double bw[TOPO_MAX_CACHES + 1];
+    for (int l = 0; l < NUM_LEVELS; l++) bw[l] = measure_read_bw(buf, levels[l].bytes);
+    free(buf);
+
+    printf("C) Single-core roofline: attainable GFLOP/s = min(peak, AI * bandwidth)\n");
+    printf("  peak: SP %.2f GF/s (%s FMA), DP %.2f GF/s (%s FMA)\n",
+           peak_fma[0], peak_isa[0], peak_fma[1], peak_isa[1]);
+    printf("  %-5s %9s %11s %14s %14s\n", "Level", "Footprint", "Read GB/s", "SP ridge f/B", "DP ridge f/B");
+    printf("  ----------------------------------------------------------\n");
+    for (int l = 0; l < NUM_LEVELS; l++) {
+        char sz[32];
+        if (levels[l].bytes >= (1u << 20)) snprintf(sz, sizeof(sz), "%zu MiB", levels[l].bytes >> 20);
+        else                               snprintf(sz, sizeof(sz), "%zu KiB", levels[l].bytes >> 10);
+        printf("  %-5s %9s %11.2f %14.2f %14.2f\n", levels[l].name, sz, bw[l],
+               peak_fma[0] / bw[l], peak_fma[1] / bw[l]);
+    }
+    printf("  (kernels with arithmetic intensity below the ridge point are bandwidth-bound at that level)\n\n");
+
+    static const double ai[] = { 0.0625, 0.125, 0.25, 0.5, 1, 2, 4, 8, 16, 32, 64 };
+    for (int dp = 1; dp >= 0; dp--) {
+        printf("  %s attainable GFLOP/s by arithmetic intensity (flop/byte)\n", dp ? "DP" : "SP");
+        printf("  %8s", "AI");
+        for (int l = 0; l < NUM_LEVELS; l++) printf(" %9s", levels[l].name);
+        printf("\n  --------");
+        for (int l = 0; l < NUM_LEVELS; l++) printf("----------");
+        printf("\n");
+        for (size_t i = 0; i < sizeof(ai) / sizeof(ai[0]); i++) {
+            printf("  %8.4g", ai[i]);
+            for (int l = 0; l < NUM_LEVELS; l++) {
+                double att = ai[i] * bw[l];
+                printf(" %9.2f", att < peak_fma[dp] ? att : peak_fma[dp]);
+            }
+            printf("\n");
+        }
+        printf("\n");
+    }
+    return 0;
+}
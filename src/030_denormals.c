@@ -0,0 +1,240 @@
+// 030_denormals.c
+// 实验目的：测 subnormal（denormal）、NaN、Inf 操作数对 FP add / mul / FMA / div 的惩罚，
+//   以及打开 FTZ / DAZ（x86 MXCSR）或 FZ（AArch64 FPCR）后惩罚是否消失
+// 方法（标量 double）：
+//   每种运算按操作数分 5 类：normal、subnormal 输入（结果为正常数）、subnormal 输出（输入均正常）、NaN、Inf
+//   latency：链式依赖；为了让每次迭代的操作数完全相同（操作数类别不随链漂移），
+//     上一次的结果只通过整数域 a_bits | (x_bits & zero) 形成假依赖，zero 运行时才知道是 0，
+//     这段固定开销对所有类别相同，惩罚 = 该类别 - normal
+//   throughput：8 组独立操作，每次迭代用空 asm 让操作数“变化”，防止编译器外提
+//   分别在默认模式和 FTZ+DAZ / FZ 模式下各测一遍
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "harness.h"
+
+#if defined(__x86_64__)
+  #include <immintrin.h>
+#endif
+
+#define REPEAT    5
+#define FREQ_GHZ  3.2
+#define ITERS     (1u << 18)
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+/*
+   -------- FP 控制寄存器 --------
+*/
+typedef struct { uint64_t saved; } fp_mode;
+
+// 打开 flush-to-zero：x86 置 MXCSR.FTZ (bit 15) 和 DAZ (bit 6)，AArch64 置 FPCR.FZ (bit 24)
+static int fp_flush_enable(fp_mode *m) {
+#if defined(__x86_64__)
+    m->saved = _mm_getcsr();
+    _mm_setcsr((unsigned)m->saved | 0x8040u);
+    return 0;
+#elif defined(__aarch64__)
+    uint64_t v;
+    __asm__ volatile("mrs %0, fpcr" : "=r"(v));
+    m->saved = v;
+    v |= 1ull << 24;
+    __asm__ volatile("msr fpcr, %0" : : "r"(v));
+    return 0;
+#else
+    (void)m;
+    return -1;
+#endif
+}
+
+static void fp_mode_restore(const fp_mode *m) {
+#if defined(__x86_64__)
+    _mm_setcsr((unsigned)m->saved);
+#elif defined(__aarch64__)
+    __asm__ volatile("msr fpcr, %0" : : "r"(m->saved));
+#else
+    (void)m;
+#endif
+}
+
+/*
+   -------- kernel --------
+*/
+#if defined(__x86_64__)
+  #define FMA_ATTR   __attribute__((target("fma")))
+  #define BAR(x)     __asm__ volatile("" : "+x"(x))
+  #define USE(x)     __asm__ volatile("" : : "x"(x))
+#elif defined(__aarch64__)
+  #define FMA_ATTR
+  #define BAR(x)     __asm__ volatile("" : "+w"(x))
+  #define USE(x)     __asm__ volatile("" : : "w"(x))
+#else
+  #define FMA_ATTR
+  #define BAR(x)     __asm__ volatile("" : "+m"(x))
+  #define USE(x)     __asm__ volatile("" : : "m"(x))
+#endif
+
+typedef struct {
+    double a, b, c;
+} operands;
+
+static volatile uint64_t zero_mask = 0;
+static volatile double fp_sink;
+
+static inline uint64_t dbits(double d) { uint64_t u; memcpy(&u, &d, 8); return u; }
+static inline double bitsd(uint64_t u) { double d; memcpy(&d, &u, 8); return d; }
+
+// EXPR 用 a / b / c 表示一次运算
+#define DEF_OP(name, ATTR, EXPR)                                            \
+    ATTR static void lat_##name(const operands *o, size_t iters) {          \
+        const double b = o->b, c = o->c;                                    \
+        const uint64_t abits = dbits(o->a), zero = zero_mask;               \
+        double x = o->a;                                                    \
+        (void)c;                                                            \
+        for (size_t i = 0; i < iters; i++) {                                \
+            double a = bitsd(abits | (dbits(x) & zero));                    \
+            x = (EXPR);                                                     \
+        }                                                                   \
+        fp_sink = x;                                                        \
+    }                                                                       \
+    ATTR static void tput_##name(const operands *o, size_t iters) {         \
+        double b = o->b, c = o->c;                                          \
+        double a0 = o->a, a1 = a0, a2 = a0, a3 = a0, a4 = a0, a5 = a0, a6 = a0, a7 = a0; \
+        (void)c;                                                            \
+        for (size_t i = 0; i < iters; i++) {                                \
+            BAR(a0); BAR(a1); BAR(a2); BAR(a3); BAR(a4); BAR(a5); BAR(a6); BAR(a7); \
+            { double a = a0; double r = (EXPR); USE(r); }                   \
+            { double a = a1; double r = (EXPR); USE(r); }                   \
+            { double a = a2; double r = (EXPR); USE(r); }                   \
+            { double a = a3; double r = (EXPR); USE(r); }                   \
+            { double a = a4; double r = (EXPR); USE(r); }                   \
+            { double a = a5; double r = (EXPR); USE(r); }                   \
+            { double a = a6; double r = (EXPR); USE(r); }                   \
+            { double a = a7; double r = (EXPR); USE(r); }                   \
+        }                                                                   \
+    }
+
+DEF_OP(add, , a + b)
+DEF_OP(mul, , a * b)
+DEF_OP(fma, FMA_ATTR, __builtin_fma(a, b, c))
+DEF_OP(div, , a / b)
+
+typedef void (*op_fn)(const operands *o, size_t iters);
+
+enum { C_NORMAL, C_SUB_IN, C_SUB_OUT, C_NAN, C_INF, NUM_CASES };
+static const char *case_names[NUM_CASES] = {
+    "normal", "subnormal input", "subnormal output", "NaN operand", "Inf operand",
+};
+
+typedef struct {
+    const char *name;
+    op_fn       lat, tput;
+    operands    cases[NUM_CASES];
+    int         enabled;
+} op_desc;
+
+// 最小正常数约 2.2e-308；1e-310 等是 subnormal
+static op_desc ops[] = {
+    { "add", lat_add, tput_add, {
+        { 1.5,     1.25,     0 },
+        { 1.5,     1e-310,   0 },           // 1.5 + sub = 1.5
+        { 3e-308,  -2.9e-308, 0 },          // 差为 1e-309
+        { NAN,     1.25,     0 },
+        { INFINITY, 1.25,    0 } }, 1 },
+    { "mul", lat_mul, tput_mul, {
+        { 1.5,     1.25,     0 },
+        { 1e300,   1e-310,   0 },           // 1e-10
+        { 1e-160,  1e-155,   0 },           // 1e-315
+        { NAN,     1.25,     0 },
+        { INFINITY, 1.25,    0 } }, 1 },
+    { "fma", lat_fma, tput_fma, {
+        { 1.5,     1.25,     0.5 },
+        { 1e300,   1e-310,   0.5 },         // 1e-10 + 0.5
+        { 1e-160,  1e-155,   0 },           // 1e-315
+        { NAN,     1.25,     0.5 },
+        { INFINITY, 1.25,    0.5 } }, 1 },
+    { "div", lat_div, tput_div, {
+        { 1.5,     1.25,     0 },
+        { 1e-310,  1e-300,   0 },           // 1e-10
+        { 1e-300,  1e10,     0 },           // 1e-310
+        { NAN,     1.25,     0 },
+        { INFINITY, 1.25,    0 } }, 1 },
+};
+#define NUM_OPS (sizeof(ops) / sizeof(ops[0]))
+
+// 返回每次操作的周期数
+static double measure(op_fn fn, const operands *o, double ops_per_iter) {
+    double samples[REPEAT];
+    fn(o, ITERS / 8);
+    for (int r = 0; r < REPEAT; r++) {
+        uint64_t t0 = now_ns();
+        fn(o, ITERS);
+        uint64_t t1 = now_ns();
+        samples[r] = (double)(t1 - t0) * FREQ_GHZ / ((double)ITERS * ops_per_iter);
+    }
+    return median(samples, REPEAT);
+}
+
+static void run_mode(const char *title) {
+    printf("%s\n", title);
+    printf("  %-4s %-17s %10s %10s %12s %12s\n", "Op", "Operands", "lat cyc", "tput cyc", "lat penalty", "tput penalty");
+    printf("  ---------------------------------------------------------------------------\n");
+    for (size_t k = 0; k < NUM_OPS; k++) {
+        if (!ops[k].enabled) continue;
+        double lat0 = 0, tput0 = 0;
+        for (int c = 0; c < NUM_CASES; c++) {
+            double lat  = measure(ops[k].lat, &ops[k].cases[c], 1.0);
+            double tput = measure(ops[k].tput, &ops[k].cases[c], 8.0);
+            if (c == C_NORMAL) { lat0 = lat; tput0 = tput; }
+            printf("  %-4s %-17s %10.2f %10.2f %+12.2f %+12.2f\n", ops[k].name, case_names[c],
+                   lat, tput, lat - lat0, tput - tput0);
+        }
+        fflush(stdout);
+    }
+    printf("\n");
+}
+
+int main(void) {
+    printf("[30] Denormal / NaN / Inf Operand Penalties (scalar double)\n");
+    printf("Assumed CPU freq = %.2f GHz; penalty = cycles above the normal-operand case of the same op\n", FREQ_GHZ);
+    printf("lat includes a fixed integer-domain dependency overhead (same for every case)\n");
+    pin_thread_to_cpu(0);
+#if defined(__x86_64__)
+    if (!__builtin_cpu_supports("fma")) {
+        ops[2].enabled = 0;
+        printf("NOTE: CPU lacks FMA, fma rows skipped.\n");
+    }
+#endif
+    printf("\n");
+
+    run_mode("A) Default FP mode (IEEE gradual underflow)");
+
+    fp_mode m;
+    if (fp_flush_enable(&m) != 0) {
+        printf("NOTE: no known FTZ/DAZ control on this platform; flush-to-zero mode skipped.\n");
+        return 0;
+    }
+#if defined(__x86_64__)
+    run_mode("B) MXCSR.FTZ + MXCSR.DAZ (subnormal inputs read as 0, subnormal results flushed to 0)");
+#else
+    run_mode("B) FPCR.FZ (subnormal inputs and results flushed to 0)");
+#endif
+    fp_mode_restore(&m);
+    return 0;
+}
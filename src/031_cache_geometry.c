@@ -0,0 +1,448 @@
+// 031_cache_geometry.c
+// 实验目的：用访问时间反推 cache 几何参数（line 大小、相联度、每路大小 / 容量）和 L1D 的替换策略，
+//   并与 sysfs cache/index* 和 cpuid（macOS 为 sysctl）报告的值交叉核对，方便给热点数组排布避开同一 set
+// 方法（全部是 pointer chasing，与 07 相同的 uint32 下标环）：
+//   A) line 大小：随机顺序访问 8 MiB 内的 512 B 块，每块访问偏移 0 和偏移 d 两处；
+//      d < line 时第二次访问命中同一行，d >= line 时变成两次 miss，每对耗时出现跳变
+//   B) 相联度：N 行循环访问。间隔一页时落进同一个 L1 set（VIPT，每路不超过一页），N 超过 L1 路数时跳变；
+//      间隔 2 MiB 时落进同一个 L2 set，N 超过 L2 路数时延迟向 L2 miss 平台上升
+//   C) 每路大小：W+1 行以步长 S 循环访问，S 达到“每路字节数”时所有行才落进同一 set 而冲突；
+//      容量 = 每路大小 * 路数，set 数 = 每路大小 / line
+//   D) L1D 替换策略：同一 L1 set（步长 = L1 每路大小，L2 中分散）上的几条构造序列，
+//      实测 miss 比例与 LRU / FIFO / tree-PLRU / bit-PLRU / random / BIP（自适应插入）的模拟结果比较，取误差最小者
+//   E) 对照 sysfs、cpuid leaf 4 / 0x8000001D、macOS sysctl 的报告值
+// 跨 2 MiB 的步长要求物理地址低 21 位与虚拟地址一致，Linux 上 madvise(MADV_HUGEPAGE)，否则 L2 的结论不可靠
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "harness.h"
+
+#if defined(__linux__)
+  #include <sys/mman.h>
+#endif
+
+#define REPEAT       5
+#define FREQ_GHZ     3.2
+#define HUGE_STRIDE  (2u << 20)
+#define MAX_LINES    40                         // B) 最多的同 set 行数
+#define BUF_BYTES    ((size_t)MAX_LINES * HUGE_STRIDE)
+#define STEPS        (1u << 20)                 // 每次测量的 chase 步数
+#define JUMP         1.3                        // 高于基准这么多倍才算出现了台阶
+#define PAIR_BLOCK   512
+#define PAIR_BYTES   (8u << 20)
+#define SLOTS        16                         // 一行里可放的 uint32 节点数（按 64 B line）
+#define SIM_ROUNDS   2000
+#define SET_OFFSET   (37 * 64)                  // 避开页首的 set，那里常有栈 / 其他数据
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+static uint32_t *base;                  // 整个缓冲区，按 uint32 下标寻址
+static volatile uint32_t chase_sink;
+
+// 把节点（uint32 下标）串成环，返回起点
+static uint32_t link_ring(const uint32_t *nodes, size_t n) {
+    for (size_t k = 0; k < n; k++) base[nodes[k]] = nodes[(k + 1) % n];
+    return nodes[0];
+}
+
+// 沿环走 steps 步，返回每步周期数（中位数）
+static double chase_cycles(uint32_t start, size_t steps) {
+    double samples[REPEAT];
+    uint32_t idx = start;
+    for (size_t i = 0; i < steps / 8; i++) idx = base[idx];
+    for (int r = 0; r < REPEAT; r++) {
+        uint64_t t0 = now_ns();
+        for (size_t i = 0; i < steps; i++) idx = base[idx];
+        uint64_t t1 = now_ns();
+        samples[r] = (double)(t1 - t0) * FREQ_GHZ / (double)steps;
+    }
+    chase_sink = idx;
+    return median(samples, REPEAT);
+}
+
+// 按行号序列建环：行 i 位于 i * stride + SET_OFFSET 字节处，同一行多次出现时依次用行内不同的 4 B 槽位
+static uint32_t build_seq(const int *seq, size_t len, size_t stride) {
+    static uint32_t nodes[1024];
+    int used[64] = { 0 };
+    for (size_t k = 0; k < len; k++) {
+        int id = seq[k];
+        nodes[k] = (uint32_t)(((size_t)id * stride + SET_OFFSET) / 4 + (size_t)used[id]++);
+    }
+    return link_ring(nodes, len);
+}
+
+static double cyclic_cycles(int n, size_t stride) {
+    int seq[64];
+    for (int i = 0; i < n; i++) seq[i] = i;
+    return chase_cycles(build_seq(seq, (size_t)n, stride), STEPS);
+}
+
+static void format_size(char *buf, size_t len, size_t n) {
+    if (n == 0)                     snprintf(buf, len, "?");
+    else if (n >= (1u << 20) && n % (1u << 20) == 0) snprintf(buf, len, "%zu MiB", n >> 20);
+    else if (n >= (1u << 10) && n % (1u << 10) == 0) snprintf(buf, len, "%zu KiB", n >> 10);
+    else                            snprintf(buf, len, "%zu B", n);
+}
+
+/*
+   -------- A) line 大小 --------
+*/
+static size_t infer_line_size(void) {
+    static const size_t ds[] = { 4, 8, 16, 32, 64, 128, 256 };
+    enum { ND = sizeof(ds) / sizeof(ds[0]) };
+    size_t nblocks = PAIR_BYTES / PAIR_BLOCK;
+    uint32_t *perm = malloc(nblocks * sizeof(uint32_t));
+    uint32_t *nodes = malloc(2 * nblocks * sizeof(uint32_t));
+    for (size_t i = 0; i < nblocks; i++) perm[i] = (uint32_t)i;
+    for (size_t i = nblocks - 1; i > 0; i--) {
+        size_t j = (size_t)rand() % (i + 1);
+        uint32_t t = perm[i]; perm[i] = perm[j]; perm[j] = t;
+    }
+
+    printf("A) Line size: random 512 B blocks over 8 MiB, two dependent loads per block at offsets 0 and d\n");
+    printf("  %6s %14s\n", "d (B)", "cycles / pair");
+    printf("  ---------------------\n");
+    double t[ND];
+    size_t line = 0;
+    for (int k = 0; k < ND; k++) {
+        for (size_t i = 0; i < nblocks; i++) {
+            nodes[2 * i]     = (uint32_t)(perm[i] * PAIR_BLOCK / 4);
+            nodes[2 * i + 1] = (uint32_t)((perm[i] * PAIR_BLOCK + ds[k]) / 4);
+        }
+        t[k] = 2.0 * chase_cycles(link_ring(nodes, 2 * nblocks), STEPS);
+        printf("  %6zu %14.1f\n", ds[k], t[k]);
+        if (!line && k > 0 && t[k] > JUMP * t[0]) line = ds[k];
+    }
+    free(perm);
+    free(nodes);
+    printf("  => line size ~ %zu B (first d where the second load misses)\n\n", line);
+    return line;
+}
+
+/*
+   -------- B) / C) 相联度与每路大小 --------
+*/
+typedef struct {
+    size_t line;
+    size_t page;
+    int    ways[2];             // L1D / L2
+    size_t way_bytes[2];
+    double hit_cycles;          // L1 命中延迟
+    double l2_cycles;           // L1 miss、L2 命中延迟
+    double mem_cycles;          // L2 miss 延迟
+} geometry;
+
+// 第一个超过阈值的 N，返回 N-1（装得下的行数），没有跳变返回 0
+static int first_over(const double *lat, int max, double thresh) {
+    for (int n = 2; n <= max; n++)
+        if (lat[n] > thresh) return n - 1;
+    return 0;
+}
+
+// L1 是 VIPT，每路大小不超过页大小，步长取页大小即可让所有行落进同一 L1 set（且在 L2 中分散）；
+// L2 是 PIPT，用 2 MiB 步长 + 大页。跳变阈值取前后两个平台（N = 1 与 N = MAX_LINES）的中点：
+// N 恰好等于路数时常有少量其他数据挤进同一 set，而某些核上大步长还会先出现一个与 L2 无关的小台阶，
+// 相邻比值容易误判。L2 多为自适应替换，超出路数后 miss 比例是逐步上升的，阈值取 1/4 处
+static void infer_ways(geometry *g) {
+    double lat1[MAX_LINES + 1], lat2[MAX_LINES + 1];
+    char sz[32];
+    format_size(sz, sizeof(sz), g->page);
+    printf("B) Associativity: N lines accessed cyclically, spaced one page (%s: same L1 set) and 2 MiB (same L2 set)\n", sz);
+    printf("  %4s %12s %12s\n", "N", "page stride", "2 MiB stride");
+    printf("  -------------------------------\n");
+    for (int n = 1; n <= MAX_LINES; n++) {
+        lat1[n] = cyclic_cycles(n, g->page);
+        lat2[n] = cyclic_cycles(n, HUGE_STRIDE);
+        printf("  %4d %12.2f %12.2f\n", n, lat1[n], lat2[n]);
+    }
+    g->hit_cycles = lat1[1];
+    g->l2_cycles  = lat1[MAX_LINES];
+    g->mem_cycles = lat2[MAX_LINES];
+    if (g->l2_cycles > JUMP * g->hit_cycles)
+        g->ways[0] = first_over(lat1, MAX_LINES, 0.5 * (g->hit_cycles + g->l2_cycles));
+    if (g->mem_cycles > JUMP * g->l2_cycles)
+        g->ways[1] = first_over(lat2, MAX_LINES, g->l2_cycles + 0.25 * (g->mem_cycles - g->l2_cycles));
+    printf("  plateaus: L1 hit %.1f, L2 hit %.1f, L2 miss %.1f cycles\n",
+           g->hit_cycles, g->l2_cycles, g->mem_cycles);
+    printf("  => L1D ways ~ %d, L2 ways ~ %d (last N below the threshold between plateaus; 0 = no step)\n\n",
+           g->ways[0], g->ways[1]);
+}
+
+static void infer_way_size(geometry *g, int level) {
+    int w = g->ways[level];
+    if (w <= 0 || w + 1 > MAX_LINES) return;
+    size_t s0 = level == 0 ? 256 : g->page;
+    size_t s1 = level == 0 ? g->page : HUGE_STRIDE;
+    printf("C%d) L%d bytes per way: %d lines (ways + 1) at stride S\n", level + 1, level + 1, w + 1);
+    printf("  %9s %10s\n", "S", "cycles");
+    printf("  --------------------\n");
+    double thresh = 0;
+    for (size_t s = s0; s <= s1; s *= 2) {
+        double c = cyclic_cycles(w + 1, s);
+        char sz[32];
+        format_size(sz, sizeof(sz), s);
+        printf("  %9s %10.2f", sz, c);
+        if (s == s0) thresh = level == 0 ? 0.5 * (c + g->l2_cycles) : g->l2_cycles + 0.25 * (g->mem_cycles - g->l2_cycles);
+        else if (!g->way_bytes[level] && c > thresh) {
+            g->way_bytes[level] = s;
+            printf("   <- all lines in one set");
+        }
+        printf("\n");
+    }
+    char sz[32], cap[32];
+    format_size(sz, sizeof(sz), g->way_bytes[level]);
+    format_size(cap, sizeof(cap), g->way_bytes[level] * (size_t)w);
+    printf("  => L%d: %s per way, capacity ~ %s, sets ~ %zu\n\n", level + 1, sz, cap,
+           g->line ? g->way_bytes[level] / g->line : 0);
+}
+
+/*
+   -------- D) 替换策略 --------
+*/
+enum { P_LRU, P_FIFO, P_TREE_PLRU, P_BIT_PLRU, P_RANDOM, P_BIP, NUM_POLICIES };
+static const char *policy_names[NUM_POLICIES] = { "LRU", "FIFO", "tree-PLRU", "bit-PLRU", "random", "BIP" };
+
+// 单个 set 的模拟，返回稳态 miss 比例
+static double simulate(int policy, int ways, const int *seq, size_t len) {
+    int tag[64];
+    uint64_t stamp[64];
+    uint8_t bits[64];               // tree-PLRU 的内部节点 / bit-PLRU 的 MRU 位
+    uint64_t clock = 0, miss = 0, total = 0;
+    unsigned rng = 12345;
+    for (int w = 0; w < ways; w++) { tag[w] = -1; stamp[w] = 0; bits[w] = 0; }
+
+    for (int round = 0; round < SIM_ROUNDS; round++) {
+        for (size_t k = 0; k < len; k++) {
+            int id = seq[k], way = -1;
+            clock++;
+            for (int w = 0; w < ways; w++) if (tag[w] == id) { way = w; break; }
+            int hit = way >= 0;
+            if (!hit) {
+                // 选 victim：先找空位
+                for (int w = 0; w < ways && way < 0; w++) if (tag[w] < 0) way = w;
+                if (way < 0) {
+                    switch (policy) {
+                    case P_LRU: case P_FIFO: case P_BIP:
+                        way = 0;
+                        for (int w = 1; w < ways; w++) if (stamp[w] < stamp[way]) way = w;
+                        break;
+                    case P_TREE_PLRU: {
+                        int node = 0;                   // 沿 bit 指向的方向走到叶子
+                        while (node < ways - 1) node = 2 * node + 1 + bits[node];
+                        way = node - (ways - 1);
+                        break;
+                    }
+                    case P_BIT_PLRU:
+                        for (int w = 0; w < ways && way < 0; w++) if (!bits[w]) way = w;
+                        if (way < 0) way = 0;
+                        break;
+                    default:
+                        rng = rng * 1103515245u + 12345u;
+                        way = (int)((rng >> 16) % (unsigned)ways);
+                    }
+                }
+                tag[way] = id;
+                if (policy == P_FIFO) stamp[way] = clock;
+            }
+            // 更新替换状态
+            switch (policy) {
+            case P_LRU:
+                stamp[way] = clock;
+                break;
+            case P_BIP:
+                // 命中提升到 MRU；新插入的行大多放在 LRU 位置，1/32 的概率放 MRU
+                rng = rng * 1103515245u + 12345u;
+                stamp[way] = (hit || ((rng >> 16) & 31) == 0) ? clock : 0;
+                break;
+            case P_TREE_PLRU: {
+                int node = way + ways - 1;              // 叶子往上，把路径上的 bit 指向另一侧
+                while (node > 0) {
+                    int parent = (node - 1) / 2;
+                    bits[parent] = (node == 2 * parent + 1) ? 1 : 0;
+                    node = parent;
+                }
+                break;
+            }
+            case P_BIT_PLRU: {
+                bits[way] = 1;
+                int all = 1;
+                for (int w = 0; w < ways; w++) all &= bits[w];
+                if (all) for (int w = 0; w < ways; w++) bits[w] = (uint8_t)(w == way);
+                break;
+            }
+            default:
+                break;
+            }
+            if (round >= SIM_ROUNDS / 4) { total++; miss += !hit; }
+        }
+    }
+    return (double)miss / (double)total;
+}
+
+static void infer_policy(const geometry *g) {
+    int w = g->ways[0];
+    size_t stride = g->way_bytes[0];
+    printf("D) L1D replacement policy (lines at stride %zu B: one L1 set, spread over L2 sets)\n", stride);
+    if (w < 2 || w > SLOTS || stride == 0 || (size_t)(2 * w) * stride > BUF_BYTES) {
+        printf("  NOTE: L1D ways / way size not inferred (or ways > %d); skipped.\n\n", SLOTS);
+        return;
+    }
+
+    double t_miss = g->l2_cycles;
+    double t_hit = cyclic_cycles(1, stride);
+
+    // 构造序列（行号）
+    static int seqs[4][256];
+    size_t lens[4] = { 0 };
+    static const char *seq_names[4] = {
+        "cyclic W+1", "hot line + W others", "W-1 hot x2 + scan", "cyclic 2W",
+    };
+    for (int i = 0; i <= w; i++) seqs[0][lens[0]++] = i;
+    for (int i = 1; i <= w; i++) { seqs[1][lens[1]++] = 0; seqs[1][lens[1]++] = i; }
+    for (int r = 0; r < 4; r++) {
+        for (int rep = 0; rep < 2; rep++)
+            for (int i = 0; i < w - 1; i++) seqs[2][lens[2]++] = i;
+        seqs[2][lens[2]++] = w - 1 + r;
+    }
+    for (int i = 0; i < 2 * w; i++) seqs[3][lens[3]++] = i;
+
+    int pow2 = (w & (w - 1)) == 0;
+    double err[NUM_POLICIES] = { 0 };
+    printf("  hit = %.2f cycles, L1 miss / L2 hit = %.2f cycles; miss%% = (t - hit) / (miss - hit)\n", t_hit, t_miss);
+    printf("  %-22s %9s", "Sequence", "measured");
+    for (int p = 0; p < NUM_POLICIES; p++) printf(" %9s", policy_names[p]);
+    printf("\n  --------------------------------");
+    for (int p = 0; p < NUM_POLICIES; p++) printf("----------");
+    printf("\n");
+    for (int s = 0; s < 4; s++) {
+        double t = chase_cycles(build_seq(seqs[s], lens[s], stride), STEPS);
+        double m = (t - t_hit) / (t_miss - t_hit);
+        if (m < 0) m = 0;
+        if (m > 1) m = 1;
+        printf("  %-22s %8.0f%%", seq_names[s], 100.0 * m);
+        for (int p = 0; p < NUM_POLICIES; p++) {
+            if (p == P_TREE_PLRU && !pow2) { printf(" %9s", "n/a"); continue; }
+            double sim = simulate(p, w, seqs[s], lens[s]);
+            err[p] += sim > m ? sim - m : m - sim;
+            printf(" %8.0f%%", 100.0 * sim);
+        }
+        printf("\n");
+    }
+    int best = -1;
+    for (int p = 0; p < NUM_POLICIES; p++) {
+        if (p == P_TREE_PLRU && !pow2) continue;
+        if (best < 0 || err[p] < err[best]) best = p;
+    }
+    printf("  => closest model: %s (mean |error| %.0f%%)\n", policy_names[best], 100.0 * err[best] / 4);
+    printf("  (BIP = LRU with insertion at the LRU position, the thrash-resistant half of adaptive DIP)\n\n");
+}
+
+/*
+   -------- E) 报告值 --------
+*/
+// 三个来源都由 harness 的 cache_info_read 读取；cpuid 的 shared 是 EAX[25:14] 给出的上限
+static void print_caches(const char *src, const cache_info *c, int n) {
+    static const char *types[] = { "Data", "Instruction", "Unified" };
+    for (int i = 0; i < n; i++) {
+        char sz[32];
+        format_size(sz, sizeof(sz), c[i].size);
+        printf("  %-7s L%d %-11s %9s %5zu %5d %7d  %d CPU(s)\n", src, c[i].level, types[c[i].type], sz,
+               c[i].line, c[i].ways, c[i].sets, c[i].shared_cpus);
+    }
+}
+
+static const cache_info *find_cache(const cache_info *c, int n, int level) {
+    for (int i = 0; i < n; i++)
+        if (c[i].level == level && c[i].type != CACHE_INST) return &c[i];
+    return NULL;
+}
+
+static void compare(const char *what, size_t inferred, size_t reported) {
+    char a[32], b[32];
+    format_size(a, sizeof(a), inferred);
+    format_size(b, sizeof(b), reported);
+    printf("  %-16s %12s %12s   %s\n", what, inferred ? a : "?", reported ? b : "?",
+           !inferred || !reported ? "-" : inferred == reported ? "match" : "DIFFERS");
+}
+
+static void compare_n(const char *what, int inferred, int reported) {
+    printf("  %-16s %12d %12d   %s\n", what, inferred, reported,
+           !inferred || !reported ? "-" : inferred == reported ? "match" : "DIFFERS");
+}
+
+int main(void) {
+    printf("[31] Cache Geometry Inference (line size, associativity, capacity, L1D replacement)\n");
+    printf("Assumed CPU freq = %.2f GHz; jump threshold = %.1fx\n", FREQ_GHZ, JUMP);
+    pin_thread_to_cpu(0);
+    srand(1);
+
+    base = aligned_alloc(HUGE_STRIDE, BUF_BYTES);
+    if (!base) {
+        fprintf(stderr, "allocation failed\n");
+        return 1;
+    }
+#if defined(MADV_HUGEPAGE)
+    if (madvise(base, BUF_BYTES, MADV_HUGEPAGE) != 0)
+        printf("NOTE: MADV_HUGEPAGE failed; L2 results assume 2 MiB physical contiguity and may be unreliable.\n");
+#else
+    printf("NOTE: no transparent huge pages on this platform; strides above the page size are physically\n"
+           "      scattered, so L2 associativity / way size may be unreliable.\n");
+#endif
+    memset(base, 0, BUF_BYTES);
+    printf("\n");
+
+    geometry g;
+    memset(&g, 0, sizeof(g));
+    g.line = infer_line_size();
+    g.page = (size_t)sysconf(_SC_PAGESIZE);
+    infer_ways(&g);
+    infer_way_size(&g, 0);
+    infer_way_size(&g, 1);
+    infer_policy(&g);
+
+    cache_info sys[TOPO_MAX_CACHES], cpu[TOPO_MAX_CACHES], mac[TOPO_MAX_CACHES];
+    int nsys = cache_info_read(CACHE_SRC_SYSFS, sys, TOPO_MAX_CACHES);
+    int ncpuid = cache_info_read(CACHE_SRC_CPUID, cpu, TOPO_MAX_CACHES);
+    int nmac = cache_info_read(CACHE_SRC_SYSCTL, mac, TOPO_MAX_CACHES);
+    printf("E) Reported cache geometry (cpu0)\n");
+    printf("  %-7s %2s %-11s %9s %5s %5s %7s  %s\n", "Source", "Lv", "Type", "Size", "Line", "Ways", "Sets", "Shared");
+    printf("  ------------------------------------------------------------------------\n");
+    print_caches("sysfs", sys, nsys);
+    print_caches("cpuid", cpu, ncpuid);
+    print_caches("sysctl", mac, nmac);
+    if (nsys + ncpuid + nmac == 0) printf("  (no source available)\n");
+    printf("\n");
+
+    // 优先 sysfs，其次 cpuid，最后 sysctl
+    const cache_info *rep = nsys ? sys : ncpuid ? cpu : mac;
+    int nrep = nsys ? nsys : ncpuid ? ncpuid : nmac;
+    const cache_info *l1 = find_cache(rep, nrep, 1), *l2 = find_cache(rep, nrep, 2);
+    printf("Inferred vs reported (%s)\n", nsys ? "sysfs" : ncpuid ? "cpuid" : nmac ? "sysctl" : "none");
+    printf("  %-16s %12s %12s\n", "", "inferred", "reported");
+    printf("  ----------------------------------------------------\n");
+    compare("line size", g.line, l1 ? l1->line : 0);
+    compare_n("L1D ways", g.ways[0], l1 ? l1->ways : 0);
+    compare("L1D size", g.way_bytes[0] * (size_t)g.ways[0], l1 ? l1->size : 0);
+    compare_n("L2 ways", g.ways[1], l2 ? l2->ways : 0);
+    compare("L2 size", g.way_bytes[1] * (size_t)g.ways[1], l2 ? l2->size : 0);
+    printf("\n");
+
+    free(base);
+    return 0;
+}
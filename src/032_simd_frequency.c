@@ -0,0 +1,433 @@
+// 032_simd_frequency.c
+// 实验目的：测活跃核数和 SIMD 宽度对实际主频的影响（Intel 的 AVX2 / AVX-512 license 降频、turbo 随核数下降），
+//   以及重 SIMD 负载开始 / 结束时频率切换的延迟；其它实验都假定 3.2 GHz，这里给出实测值
+// 方法：
+//   频率探针：一条依赖的整数 add 链（每条 1 周期，与 SIMD license 无关），周期数已知，主频 = add 数 / 耗时
+//   负载 kernel：scalar（标量 double FMA）、256 位（AVX2 FMA）、512 位（AVX-512F FMA），多条独立链压满 FP 单元；
+//     arm64 上是标量和 NEON 128 位
+//   工作线程循环执行“一段负载 kernel + 一次探针”，探针很短，license 的保持时间（ms 级）远长于它，
+//   所以探针测到的就是负载 kernel 所处的频率
+//   A) 1..N 个线程（线程 i 绑 cpu i）同时跑同一种 kernel，报告每核有效频率和每核 GFLOP/s
+//   B) 单线程时间线：先只跑探针，再切到重 SIMD（kernel 段很短，时间分辨率 ~µs），再切回探针，
+//      报告频率下降 / 恢复的延迟、切换瞬间的停顿，以及宽向量单元上电前 kernel 变慢的时长
+//   C) 邻居影响：cpu 0 只跑探针，其余 CPU 跑 scalar 或 512 位 kernel，看 cpu 0 的频率是否被拖低
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "harness.h"
+
+#if defined(__x86_64__)
+  #include <immintrin.h>
+#elif defined(__aarch64__)
+  #include <arm_neon.h>
+#endif
+
+#define FREQ_GHZ      3.2
+#define MAX_THREADS   256
+#define WINDOW_MS     300
+#define PROBE_LOOPS   256                       // 探针循环次数，每次 16 条 add
+#define PROBE_ADDS    (PROBE_LOOPS * 16)
+#define CHUNK_ITERS   8192                      // A / C) 每段 kernel 的迭代次数（~10 µs）
+#define TL_ITERS      1024                      // B) 时间线上每段 kernel 的迭代次数（~1 µs）
+#define MAX_SAMPLES   8192                      // 每线程记录的探针样本数上限
+#define TL_PRE_MS     3
+#define TL_HEAVY_MS   15
+#define TL_POST_MS    15
+#define TL_MAX        65536
+#define SETTLE        0.02                      // 与稳态相差 2% 以内算稳定
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+/*
+   -------- 频率探针 --------
+*/
+// 加数放寄存器：Golden Cove 等核心能在 rename 阶段折叠 add 立即数链，测出的“频率”会高出数倍
+#if defined(__x86_64__)
+  #define ADD16(x, y) __asm__ volatile(".rept 16\n\tadd %1, %0\n\t.endr" : "+r"(x) : "r"(y))
+  #define HAVE_PROBE 1
+#elif defined(__aarch64__)
+  #define ADD16(x, y) __asm__ volatile(".rept 16\n\tadd %0, %0, %1\n\t.endr" : "+r"(x) : "r"(y))
+  #define HAVE_PROBE 1
+#else
+  #define ADD16(x, y) ((x) += 16 * (y))
+  #define HAVE_PROBE 0
+#endif
+
+static volatile uint64_t probe_sink;
+static uint64_t timer_oh;
+
+// 返回探针耗时（ns，已扣除计时开销）
+static double probe_ns(void) {
+    uint64_t x = 0, y = 1;
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < PROBE_LOOPS; i++) ADD16(x, y);
+    uint64_t t1 = now_ns();
+    probe_sink = x;
+    double ns = (double)(t1 - t0) - (double)timer_oh;
+    return ns > 1 ? ns : 1;
+}
+
+/*
+   -------- 负载 kernel --------
+   NACC 条独立 FMA 链，x = x * m + c，值保持在正常数范围；各链初值不同，防止被合并
+*/
+static volatile double flop_sink;
+
+#define DEF_HEAVY(name, ATTR, T, SET1, FMA, ADD, BAR)                       \
+    ATTR static void name(size_t iters) {                                   \
+        const T m = SET1(0.9999999), c = SET1(1e-7);                        \
+        T x0 = SET1(1.00), x1 = SET1(1.01), x2 = SET1(1.02), x3 = SET1(1.03); \
+        T x4 = SET1(1.04), x5 = SET1(1.05), x6 = SET1(1.06), x7 = SET1(1.07); \
+        T x8 = SET1(1.08), x9 = SET1(1.09), x10 = SET1(1.10), x11 = SET1(1.11); \
+        for (size_t i = 0; i < iters; i++) {                                \
+            x0 = FMA(x0, m, c); x1 = FMA(x1, m, c); x2 = FMA(x2, m, c); x3 = FMA(x3, m, c); \
+            x4 = FMA(x4, m, c); x5 = FMA(x5, m, c); x6 = FMA(x6, m, c); x7 = FMA(x7, m, c); \
+            x8 = FMA(x8, m, c); x9 = FMA(x9, m, c); x10 = FMA(x10, m, c); x11 = FMA(x11, m, c); \
+            BAR(x0); BAR(x1); BAR(x2); BAR(x3); BAR(x4); BAR(x5);           \
+            BAR(x6); BAR(x7); BAR(x8); BAR(x9); BAR(x10); BAR(x11);         \
+        }                                                                   \
+        T s = ADD(ADD(ADD(x0, x1), ADD(x2, x3)), ADD(ADD(x4, x5), ADD(x6, x7))); \
+        s = ADD(s, ADD(ADD(x8, x9), ADD(x10, x11)));                        \
+        double out;                                                         \
+        memcpy(&out, &s, sizeof(out));                                      \
+        flop_sink = out;                                                    \
+    }
+#define NACC 12
+
+#define NO_BAR(x)        ((void)0)
+#define SCALAR_SET1(v)   (v)
+#define SCALAR_ADD(a, b) ((a) + (b))
+
+// 标量链之间加空 asm 屏障，防止被 SLP 向量化
+#if defined(__x86_64__)
+  #define SCALAR_ATTR   __attribute__((target("fma")))
+  #define SCALAR_BAR(x) __asm__("" : "+x"(x))
+#elif defined(__aarch64__)
+  #define SCALAR_ATTR
+  #define SCALAR_BAR(x) __asm__("" : "+w"(x))
+#else
+  #define SCALAR_ATTR
+  #define SCALAR_BAR(x) ((void)0)
+#endif
+DEF_HEAVY(heavy_scalar, SCALAR_ATTR, double, SCALAR_SET1, __builtin_fma, SCALAR_ADD, SCALAR_BAR)
+
+#if defined(__x86_64__)
+  DEF_HEAVY(heavy_256, __attribute__((target("avx2,fma"))), __m256d, _mm256_set1_pd, _mm256_fmadd_pd, _mm256_add_pd, NO_BAR)
+  DEF_HEAVY(heavy_512, __attribute__((target("avx512f"))), __m512d, _mm512_set1_pd, _mm512_fmadd_pd, _mm512_add_pd, NO_BAR)
+#elif defined(__aarch64__)
+  #define NEON_FMA(x, m, c) vfmaq_f64((c), (x), (m))
+  DEF_HEAVY(heavy_128, , float64x2_t, vdupq_n_f64, NEON_FMA, vaddq_f64, NO_BAR)
+#endif
+
+typedef void (*kernel_fn)(size_t iters);
+
+typedef struct {
+    const char *name;
+    int         bits;
+    int         lanes;          // double 元素数
+    kernel_fn   fn;
+    int         enabled;
+} kernel_desc;
+
+static kernel_desc kernels[] = {
+    { "scalar",  64, 1, heavy_scalar, 1 },
+#if defined(__x86_64__)
+    { "AVX2",    256, 4, heavy_256, 1 },
+    { "AVX-512", 512, 8, heavy_512, 1 },
+#elif defined(__aarch64__)
+    { "NEON",    128, 2, heavy_128, 1 },
+#endif
+};
+#define NUM_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+/*
+   -------- A / C) 多线程 --------
+*/
+typedef struct {
+    int           cpu;
+    kernel_fn     fn;               // NULL = 只跑探针
+    volatile int *start;
+    volatile int *stop;
+    double       *ghz;              // 探针样本
+    size_t        nsamples;
+    uint64_t      iters;            // kernel 迭代总数
+    uint64_t      kernel_ns;        // kernel 总耗时
+} thread_arg;
+
+static void *run_worker(void *arg) {
+    thread_arg *a = arg;
+    pin_thread_to_cpu(a->cpu);
+    size_t n = 0;
+    uint64_t iters = 0, kns = 0;
+    while (!*a->start) { /* spin */ }
+    while (!*a->stop) {
+        if (a->fn) {
+            uint64_t t0 = now_ns();
+            a->fn(CHUNK_ITERS);
+            kns += now_ns() - t0;
+            iters += CHUNK_ITERS;
+        }
+        double ns = probe_ns();
+        if (n < MAX_SAMPLES) a->ghz[n++] = PROBE_ADDS / ns;
+    }
+    a->nsamples = n;
+    a->iters = iters;
+    a->kernel_ns = kns;
+    return NULL;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static int thread_counts(int max, int *out) {
+    int n = 0;
+    for (int t = 1; t < max; t *= 2) out[n++] = t;
+    out[n++] = max;
+    return n;
+}
+
+// n 个线程，线程 i 绑 cpu i % ncpu；fns[i] 是线程 i 的 kernel。结果留在 args 里
+static void run_threads(thread_arg *args, kernel_fn *fns, int n, int ncpu, double *ghz_buf) {
+    pthread_t th[MAX_THREADS];
+    volatile int start = 0, stop = 0;
+    for (int i = 0; i < n; i++) {
+        args[i] = (thread_arg){ .cpu = i % ncpu, .fn = fns[i], .start = &start, .stop = &stop,
+                                .ghz = ghz_buf + (size_t)i * MAX_SAMPLES };
+        pthread_create(&th[i], NULL, run_worker, &args[i]);
+    }
+    start = 1;
+    sleep_ms(WINDOW_MS);
+    stop = 1;
+    for (int i = 0; i < n; i++) pthread_join(th[i], NULL);
+}
+
+// 去掉前 1/4 样本（频率还在切换），其余取中位数
+static double steady_ghz(thread_arg *a) {
+    size_t skip = a->nsamples / 4;
+    if (a->nsamples - skip == 0) return 0;
+    return median(a->ghz + skip, a->nsamples - skip);
+}
+
+/*
+   -------- B) 时间线 --------
+*/
+typedef struct {
+    double t_us;                // 相对于 heavy 开始的时间
+    double ghz;                 // 探针频率
+    double kernel_ns;           // 这一段 kernel 的耗时（0 = 没跑 kernel）
+} tl_sample;
+
+static tl_sample timeline[TL_MAX];
+
+static size_t record_timeline(kernel_fn fn) {
+    size_t n = 0;
+    uint64_t begin = now_ns();
+    uint64_t heavy_start = begin + (uint64_t)TL_PRE_MS * 1000000u;
+    uint64_t heavy_end = heavy_start + (uint64_t)TL_HEAVY_MS * 1000000u;
+    uint64_t end = heavy_end + (uint64_t)TL_POST_MS * 1000000u;
+    for (uint64_t t = begin; t < end && n < TL_MAX; t = now_ns()) {
+        double kns = 0;
+        if (t >= heavy_start && t < heavy_end) {
+            fn(TL_ITERS);
+            kns = (double)(now_ns() - t);
+        }
+        double ns = probe_ns();
+        timeline[n++] = (tl_sample){ ((double)t - (double)heavy_start) / 1e3, PROBE_ADDS / ns, kns };
+    }
+    return n;
+}
+
+// [from, to) 时间段内探针频率的中位数
+static double tl_median_ghz(size_t n, double from, double to) {
+    static double tmp[TL_MAX];
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++)
+        if (timeline[i].t_us >= from && timeline[i].t_us < to) tmp[k++] = timeline[i].ghz;
+    return k ? median(tmp, k) : 0;
+}
+
+// 同上，kernel 段耗时
+static double tl_median_kernel(size_t n, double from, double to) {
+    static double tmp[TL_MAX];
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++)
+        if (timeline[i].kernel_ns > 0 && timeline[i].t_us >= from && timeline[i].t_us < to)
+            tmp[k++] = timeline[i].kernel_ns;
+    return k ? median(tmp, k) : 0;
+}
+
+// 从 from 开始，SETTLE_WIN 个样本的滑动中位数第一次进入 target ± SETTLE 的时刻（相对 from，µs）；-1 = 没进入
+// 用滑动中位数而不是“最后一次越界”，单个被打断的样本不会把结果拖到窗口末尾
+#define SETTLE_WIN 9
+static double settle_time(size_t n, double from, double to, double target, int use_kernel) {
+    for (size_t i = 0; i + SETTLE_WIN <= n; i++) {
+        if (timeline[i].t_us < from) continue;
+        if (timeline[i + SETTLE_WIN - 1].t_us >= to) break;
+        double w[SETTLE_WIN];
+        for (int k = 0; k < SETTLE_WIN; k++) w[k] = use_kernel ? timeline[i + k].kernel_ns : timeline[i + k].ghz;
+        double v = median(w, SETTLE_WIN);
+        if (v >= target * (1 - SETTLE) && v <= target * (1 + SETTLE)) return timeline[i].t_us - from;
+    }
+    return -1;
+}
+
+static void run_timeline(const kernel_desc *k) {
+    size_t n = record_timeline(k->fn);
+    double heavy = TL_HEAVY_MS * 1e3;
+    double base = tl_median_ghz(n, -TL_PRE_MS * 1e3, 0);
+    double hot = tl_median_ghz(n, heavy / 2, heavy);
+    double after = tl_median_ghz(n, heavy + TL_POST_MS * 1e3 / 2, heavy + TL_POST_MS * 1e3);
+    double kst = tl_median_kernel(n, heavy / 2, heavy);
+    double down = settle_time(n, 0, heavy, hot, 0);
+    double up = settle_time(n, heavy, heavy + TL_POST_MS * 1e3, after, 0);
+    double warm = settle_time(n, 0, heavy, kst, 1);
+    // 切换瞬间的停顿：heavy 开始 / 结束后 200 µs 内最慢的一次探针，折合成微秒
+    double stall_on = 0, stall_off = 0;
+    for (size_t i = 0; i < n; i++) {
+        double us = PROBE_ADDS / timeline[i].ghz / 1e3;
+        if (timeline[i].t_us >= 0 && timeline[i].t_us < 200 && us > stall_on) stall_on = us;
+        if (timeline[i].t_us >= heavy && timeline[i].t_us < heavy + 200 && us > stall_off) stall_off = us;
+    }
+    double probe_us = PROBE_ADDS / hot / 1e3;
+
+    int changed = hot < base * (1 - SETTLE) || hot > base * (1 + SETTLE);
+    printf("  %-8s %7.3f %7.3f %7.3f %+7.1f%% |", k->name, base, hot, after, (hot / base - 1) * 100);
+    if (!changed)      printf(" %9s %9s", "-", "-");
+    else {
+        if (down < 0)  printf(" %9s", "unstable");
+        else           printf(" %9.1f", down);
+        if (up < 0)    printf(" %9s", "unstable");
+        else           printf(" %9.1f", up);
+    }
+    if (warm < 0) printf(" %10s", "unstable");
+    else          printf(" %10.1f", warm);
+    printf(" | %9.1f %9.1f  (%zu samples, probe %.2f us)\n", stall_on - probe_us, stall_off - probe_us, n, probe_us);
+    fflush(stdout);
+}
+
+int main(void) {
+    int ncpu = num_online_cpus();
+    int max_threads = ncpu < MAX_THREADS ? ncpu : MAX_THREADS;
+
+    printf("[32] All-Core Frequency and SIMD License Behavior\n");
+    printf("Online CPUs: %d; probe = %d dependent integer adds (1 cycle each), freq = adds / probe time\n",
+           ncpu, PROBE_ADDS);
+    printf("Other benchmarks assume %.2f GHz\n", FREQ_GHZ);
+    if (pin_thread_to_cpu(0) != 0)
+        printf("NOTE: thread pinning unavailable on this platform; threads float.\n");
+    if (!HAVE_PROBE)
+        printf("NOTE: no add-chain probe for this architecture; frequencies below are not meaningful.\n");
+#if defined(__x86_64__)
+    for (size_t k = 0; k < NUM_KERNELS; k++) {
+        if (!__builtin_cpu_supports("fma")) kernels[k].enabled = 0;
+        if (kernels[k].bits == 256 && !__builtin_cpu_supports("avx2")) kernels[k].enabled = 0;
+        if (kernels[k].bits == 512 && !__builtin_cpu_supports("avx512f")) kernels[k].enabled = 0;
+    }
+    if (!__builtin_cpu_supports("fma"))
+        printf("NOTE: CPU lacks FMA; kernels are compiled for FMA-capable x86, all skipped.\n");
+    else if (!__builtin_cpu_supports("avx512f"))
+        printf("NOTE: AVX-512F not available, 512-bit rows skipped.\n");
+#endif
+    timer_oh = timer_overhead_ns();
+    warmup_busy_loop(50000);
+    probe_ns();
+    printf("\n");
+
+    double *ghz_buf = malloc(sizeof(double) * MAX_SAMPLES * (size_t)max_threads);
+    if (!ghz_buf) {
+        fprintf(stderr, "allocation failed\n");
+        return 1;
+    }
+    thread_arg args[MAX_THREADS];
+    kernel_fn fns[MAX_THREADS];
+
+    // A) 频率 vs 活跃核数
+    int counts[32];
+    int num_counts = thread_counts(max_threads, counts);
+    printf("A) Effective frequency with 1..N active cores (thread i on cpu i, %d ms window)\n", WINDOW_MS);
+    printf("  %-8s %7s | %9s %9s %9s | %11s %9s\n", "Kernel", "Threads", "avg GHz", "min GHz", "max GHz",
+           "GF/s/core", "f/cycle");
+    printf("  ---------------------------------------------------------------------------\n");
+    for (int c = -1; c < (int)NUM_KERNELS; c++) {
+        if (c >= 0 && !kernels[c].enabled) continue;
+        for (int k = 0; k < num_counts; k++) {
+            int n = counts[k];
+            for (int i = 0; i < n; i++) fns[i] = c >= 0 ? kernels[c].fn : NULL;
+            run_threads(args, fns, n, ncpu, ghz_buf);
+            double sum = 0, lo = 1e9, hi = 0, gf = 0;
+            for (int i = 0; i < n; i++) {
+                double g = steady_ghz(&args[i]);
+                sum += g;
+                if (g < lo) lo = g;
+                if (g > hi) hi = g;
+                if (c >= 0 && args[i].kernel_ns > 0)
+                    gf += (double)args[i].iters * NACC * kernels[c].lanes * 2 / (double)args[i].kernel_ns;
+            }
+            if (c < 0) {
+                printf("  %-8s %7d | %9.3f %9.3f %9.3f | %11s %9s\n", "probe", n, sum / n, lo, hi, "-", "-");
+            } else {
+                printf("  %-8s %7d | %9.3f %9.3f %9.3f | %11.2f %9.2f\n", kernels[c].name, n, sum / n, lo, hi,
+                       gf / n, gf / n / (sum / n));
+            }
+            fflush(stdout);
+        }
+    }
+    printf("  (probe = add chain only, no FP load; f/cycle = flops per measured cycle, FMA counts 2)\n\n");
+
+    // B) 时间线
+    printf("B) Transition timeline on cpu 0: %d ms probe only -> %d ms kernel + probe -> %d ms probe only\n",
+           TL_PRE_MS, TL_HEAVY_MS, TL_POST_MS);
+    printf("  %-8s %7s %7s %7s %8s | %9s %9s %10s | %9s %9s\n", "Kernel", "before", "during", "after", "change",
+           "down us", "up us", "warmup us", "stall on", "stall off");
+    printf("  ---------------------------------------------------------------------------------------------\n");
+    for (size_t k = 0; k < NUM_KERNELS; k++)
+        if (kernels[k].enabled) run_timeline(&kernels[k]);
+    printf("  (GHz from the probe; down / up = time until the probe frequency settles within %.0f%% of the\n"
+           "   new steady state after the kernel starts / stops, '-' when the frequency did not change;\n"
+           "   warmup = time until the kernel's own speed settles, e.g. while wide units power up;\n"
+           "   stall = slowest probe within 200 us of the switch minus a normal probe, in us)\n\n", SETTLE * 100);
+
+    // C) 邻居影响
+    printf("C) Neighbor effect: cpu 0 runs the probe only, the other CPUs run a kernel\n");
+    if (max_threads < 2) {
+        printf("NOTE: only one CPU online; neighbor test skipped.\n\n");
+    } else {
+        printf("  %-10s %9s %12s\n", "Neighbors", "cpu0 GHz", "vs idle");
+        printf("  ----------------------------------\n");
+        double idle = 0;
+        for (int c = -1; c < (int)NUM_KERNELS; c++) {
+            if (c >= 0 && !kernels[c].enabled) continue;
+            int n = c < 0 ? 1 : max_threads;
+            fns[0] = NULL;
+            for (int i = 1; i < n; i++) fns[i] = kernels[c].fn;
+            run_threads(args, fns, n, ncpu, ghz_buf);
+            double g = steady_ghz(&args[0]);
+            if (c < 0) idle = g;
+            printf("  %-10s %9.3f %+11.1f%%\n", c < 0 ? "idle" : kernels[c].name, g, (g / idle - 1) * 100);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+
+    free(ghz_buf);
+    return 0;
+}
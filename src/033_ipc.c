@@ -0,0 +1,523 @@
+// 033_ipc.c
+// 实验目的：进程间搬数据的吞吐与延迟（01 只测了 getpid 和线程间信号量 ping-pong，没有数据量）
+// 方法：fork 出一个子进程（父进程绑 cpu 0，子进程绑另一个 CPU），消息大小 64 B .. 4 MiB：
+//   pipe              ：write / read，Linux 上管道扩到 RING_BYTES（F_SETPIPE_SZ）
+//   socketpair        ：AF_UNIX SOCK_STREAM，默认缓冲区
+//   vmsplice + read   ：发送端 vmsplice 把用户页挂进管道（发送侧零拷贝），接收端 read 拷出（Linux）
+//   vmsplice + splice ：接收端 splice 到 /dev/null，数据完全不进接收进程，是零拷贝路径的上限（Linux）
+//   memfd ring        ：memfd_create + mmap 的共享内存 SPSC 环，双方 memcpy 进出；
+//                       等待时先自旋再 sched_yield，不经过内核唤醒（非 Linux 用 MAP_SHARED 匿名映射）
+//   TCP loopback      ：127.0.0.1，TCP_NODELAY，默认缓冲区
+//   A) 吞吐：父进程连续发送约 TARGET_BYTES，子进程全部收完后经控制管道回 1 字节，GB/s
+//   B) 延迟：同样大小的消息 ping-pong，单程 = 往返 / 2（µs）
+// 所有结果 REPEAT 次取中位数
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "harness.h"
+
+#define REPEAT        3
+#define TARGET_BYTES  (256u << 20)      // A) 每个点大约发送的字节数
+#define MAX_MSGS      100000u           // A) 小消息时的消息数上限
+#define LAT_BYTES     (64u << 20)       // B) 每个点 ping-pong 的总字节数
+#define MAX_ROUNDS    20000u
+#define MIN_ROUNDS    20u
+#define RING_BYTES    (1u << 20)        // 共享内存环 / 管道容量
+#define MAX_MSG       (4u << 20)
+#define TIMEOUT_NS    (10ull * 1000000000ull)
+
+static const size_t sizes[] = { 64, 256, 1024, 4096, 16384, 65536, 262144, 1048576, 4194304 };
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+// 中位数
+static double median(double *a, size_t n) {
+    for (size_t i = 1; i < n; ++i) {
+        double key = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            --j;
+        }
+        a[j] = key;
+    }
+    return (n % 2) ? a[n/2] : 0.5 * (a[n/2 - 1] + a[n/2]);
+}
+
+/*
+   -------- 共享内存 SPSC 环 --------
+   head / tail 是累计字节数，各占一条 cache line；生产者只写 head，消费者只写 tail
+*/
+typedef struct {
+    _Atomic uint64_t head;
+    char             pad0[56];
+    _Atomic uint64_t tail;
+    char             pad1[56];
+    uint8_t          data[RING_BYTES];
+} shm_ring;
+
+// 自旋一段时间后让出 CPU（单核机器上两个进程共用一个 CPU 时也能推进）；超时返回 -1
+static int ring_wait(uint64_t *spins, uint64_t *deadline) {
+    if (++*spins < 256) return 0;
+    sched_yield();
+    if ((*spins & 1023) == 0) {
+        uint64_t t = now_ns();
+        if (*deadline == 0) *deadline = t + TIMEOUT_NS;
+        else if (t > *deadline) return -1;
+    }
+    return 0;
+}
+
+static int ring_send(shm_ring *r, const uint8_t *buf, size_t len) {
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint64_t spins = 0, deadline = 0;
+    while (len > 0) {
+        uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        size_t space = RING_BYTES - (size_t)(head - tail);
+        if (space == 0) {
+            if (ring_wait(&spins, &deadline) != 0) return -1;
+            continue;
+        }
+        size_t off = (size_t)(head % RING_BYTES);
+        size_t n = len < space ? len : space;
+        if (n > RING_BYTES - off) n = RING_BYTES - off;
+        memcpy(r->data + off, buf, n);
+        head += n;
+        buf += n;
+        len -= n;
+        atomic_store_explicit(&r->head, head, memory_order_release);
+        spins = 0;
+        deadline = 0;
+    }
+    return 0;
+}
+
+static int ring_recv(shm_ring *r, uint8_t *buf, size_t len) {
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint64_t spins = 0, deadline = 0;
+    while (len > 0) {
+        uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        size_t avail = (size_t)(head - tail);
+        if (avail == 0) {
+            if (ring_wait(&spins, &deadline) != 0) return -1;
+            continue;
+        }
+        size_t off = (size_t)(tail % RING_BYTES);
+        size_t n = len < avail ? len : avail;
+        if (n > RING_BYTES - off) n = RING_BYTES - off;
+        memcpy(buf, r->data + off, n);
+        tail += n;
+        buf += n;
+        len -= n;
+        atomic_store_explicit(&r->tail, tail, memory_order_release);
+        spins = 0;
+        deadline = 0;
+    }
+    return 0;
+}
+
+/*
+   -------- 通道：每种机制给出父子两端 --------
+   wfd / rfd 是本进程的发送 / 接收 fd（socket 两者相同），tx / rx 是共享内存环
+*/
+typedef struct {
+    int       wfd, rfd;
+    shm_ring *tx, *rx;
+    int       null_fd;          // vmsplice + splice 的接收端
+} endpoint;
+
+enum { M_PIPE, M_SOCKETPAIR, M_VMSPLICE_READ, M_VMSPLICE_SPLICE, M_SHM, M_TCP, NUM_MECHS };
+static const char *mech_names[NUM_MECHS] = {
+    "pipe", "socketpair", "vmsplice+read", "vmsplice+splice", "memfd ring", "TCP loopback",
+};
+
+static int write_all(int fd, const uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = read(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+#if defined(__linux__)
+// vmsplice 只是把页挂进管道；发送缓冲区在本实验里内容不变，所以不必等接收端消费完再复用
+static int vmsplice_all(int fd, const uint8_t *buf, size_t len) {
+    while (len > 0) {
+        struct iovec iov = { (void *)buf, len };
+        ssize_t n = vmsplice(fd, &iov, 1, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int splice_all(int fd, int null_fd, size_t len) {
+    while (len > 0) {
+        ssize_t n = splice(fd, NULL, null_fd, NULL, len, SPLICE_F_MOVE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+#endif
+
+static int ep_send(int mech, endpoint *e, const uint8_t *buf, size_t len) {
+    switch (mech) {
+#if defined(__linux__)
+    case M_VMSPLICE_READ:
+    case M_VMSPLICE_SPLICE: return vmsplice_all(e->wfd, buf, len);
+#endif
+    case M_SHM:             return ring_send(e->tx, buf, len);
+    default:                return write_all(e->wfd, buf, len);
+    }
+}
+
+static int ep_recv(int mech, endpoint *e, uint8_t *buf, size_t len) {
+    switch (mech) {
+#if defined(__linux__)
+    case M_VMSPLICE_SPLICE: return splice_all(e->rfd, e->null_fd, len);
+#endif
+    case M_SHM:             return ring_recv(e->rx, buf, len);
+    default:                return read_all(e->rfd, buf, len);
+    }
+}
+
+static void enlarge_pipe(int fd) {
+#if defined(F_SETPIPE_SZ)
+    fcntl(fd, F_SETPIPE_SZ, RING_BYTES);
+#else
+    (void)fd;
+#endif
+}
+
+static int make_pipes(endpoint *parent, endpoint *child) {
+    int ab[2], ba[2];
+    if (pipe(ab) != 0) return -1;
+    if (pipe(ba) != 0) { close(ab[0]); close(ab[1]); return -1; }
+    enlarge_pipe(ab[1]);
+    enlarge_pipe(ba[1]);
+    parent->wfd = ab[1]; parent->rfd = ba[0];
+    child->wfd = ba[1];  child->rfd = ab[0];
+    return 0;
+}
+
+static int make_tcp(endpoint *parent, endpoint *child) {
+    int ls = socket(AF_INET, SOCK_STREAM, 0);
+    if (ls < 0) return -1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    int cs = -1, as = -1;
+    if (bind(ls, (struct sockaddr *)&addr, sizeof(addr)) == 0 && listen(ls, 1) == 0 &&
+        getsockname(ls, (struct sockaddr *)&addr, &alen) == 0 &&
+        (cs = socket(AF_INET, SOCK_STREAM, 0)) >= 0 &&
+        connect(cs, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+        as = accept(ls, NULL, NULL);
+    close(ls);
+    if (as < 0) {
+        if (cs >= 0) close(cs);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(cs, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(as, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    parent->wfd = parent->rfd = cs;
+    child->wfd = child->rfd = as;
+    return 0;
+}
+
+static shm_ring *map_rings(void) {
+    size_t bytes = 2 * sizeof(shm_ring);
+    void *p = MAP_FAILED;
+#if defined(__linux__)
+    int fd = memfd_create("ipc_ring", 0);
+    if (fd >= 0) {
+        if (ftruncate(fd, (off_t)bytes) == 0)
+            p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+#endif
+    if (p == MAP_FAILED)
+        p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    memset(p, 0, bytes);
+    return p;
+}
+
+// 建立通道，返回 0 成功
+static int make_channel(int mech, endpoint *parent, endpoint *child) {
+    memset(parent, 0, sizeof(*parent));
+    memset(child, 0, sizeof(*child));
+    parent->wfd = parent->rfd = child->wfd = child->rfd = -1;
+    parent->null_fd = child->null_fd = -1;
+    switch (mech) {
+    case M_PIPE:
+        return make_pipes(parent, child);
+    case M_SOCKETPAIR: {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) return -1;
+        parent->wfd = parent->rfd = sv[0];
+        child->wfd = child->rfd = sv[1];
+        return 0;
+    }
+#if defined(__linux__)
+    case M_VMSPLICE_READ:
+        return make_pipes(parent, child);
+    case M_VMSPLICE_SPLICE:
+        if (make_pipes(parent, child) != 0) return -1;
+        parent->null_fd = open("/dev/null", O_WRONLY);
+        child->null_fd = open("/dev/null", O_WRONLY);
+        return parent->null_fd >= 0 && child->null_fd >= 0 ? 0 : -1;
+#endif
+    case M_SHM: {
+        shm_ring *r = map_rings();
+        if (!r) return -1;
+        parent->tx = &r[0]; parent->rx = &r[1];
+        child->tx = &r[1];  child->rx = &r[0];
+        return 0;
+    }
+    case M_TCP:
+        return make_tcp(parent, child);
+    default:
+        return -1;
+    }
+}
+
+static void close_fd(int fd, const endpoint *keep) {
+    if (fd < 0) return;
+    if (keep && (fd == keep->wfd || fd == keep->rfd || fd == keep->null_fd)) return;
+    close(fd);
+}
+
+// 关掉 e 的 fd，但保留 keep 里也在用的（socket 两端同一个 fd）
+static void close_endpoint(const endpoint *e, const endpoint *keep) {
+    close_fd(e->wfd, keep);
+    if (e->rfd != e->wfd) close_fd(e->rfd, keep);
+    close_fd(e->null_fd, keep);
+}
+
+/*
+   -------- 测量协议 --------
+   父子两边按相同的 sizes / REPEAT 顺序执行，消息数和轮数都由 size 算出，不需要额外协商
+*/
+static size_t tput_msgs(size_t size) {
+    size_t n = TARGET_BYTES / size;
+    if (n > MAX_MSGS) n = MAX_MSGS;
+    return n < 16 ? 16 : n;
+}
+
+static size_t lat_rounds(size_t size) {
+    size_t n = LAT_BYTES / size;
+    if (n > MAX_ROUNDS) n = MAX_ROUNDS;
+    return n < MIN_ROUNDS ? MIN_ROUNDS : n;
+}
+
+static int child_loop(int mech, endpoint *e, int ctl, uint8_t *buf) {
+    const uint8_t ack = 1;
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        size_t size = sizes[s];
+        for (int r = 0; r < REPEAT; r++) {
+            for (size_t i = 0; i < tput_msgs(size); i++)
+                if (ep_recv(mech, e, buf, size) != 0) return -1;
+            if (write_all(ctl, &ack, 1) != 0) return -1;
+        }
+        for (int r = 0; r < REPEAT; r++) {
+            for (size_t i = 0; i < lat_rounds(size); i++) {
+                if (ep_recv(mech, e, buf, size) != 0) return -1;
+                if (ep_send(mech, e, buf, size) != 0) return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// 结果：GB/s 和单程 µs，失败为 0
+static void parent_loop(int mech, endpoint *e, int ctl, uint8_t *sbuf, uint8_t *rbuf,
+                        double *gbps, double *lat_us) {
+    double samples[REPEAT];
+    uint8_t ack;
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        size_t size = sizes[s];
+        size_t msgs = tput_msgs(size), rounds = lat_rounds(size);
+        for (int r = 0; r < REPEAT; r++) {
+            uint64_t t0 = now_ns();
+            for (size_t i = 0; i < msgs; i++)
+                if (ep_send(mech, e, sbuf, size) != 0) return;
+            if (read_all(ctl, &ack, 1) != 0) return;
+            uint64_t t1 = now_ns();
+            samples[r] = (double)size * (double)msgs / (double)(t1 - t0);
+        }
+        gbps[s] = median(samples, REPEAT);
+        for (int r = 0; r < REPEAT; r++) {
+            uint64_t t0 = now_ns();
+            for (size_t i = 0; i < rounds; i++) {
+                if (ep_send(mech, e, sbuf, size) != 0) return;
+                if (ep_recv(mech, e, rbuf, size) != 0) return;
+            }
+            uint64_t t1 = now_ns();
+            samples[r] = (double)(t1 - t0) / (double)rounds / 2.0 / 1e3;
+        }
+        lat_us[s] = median(samples, REPEAT);
+    }
+}
+
+// 一种机制：建通道、fork、跑完所有大小；不可用返回 -1
+static int run_mech(int mech, int child_cpu, uint8_t *sbuf, uint8_t *rbuf, double *gbps, double *lat_us) {
+    endpoint pe, ce;
+    if (make_channel(mech, &pe, &ce) != 0) {
+        close_endpoint(&pe, NULL);
+        close_endpoint(&ce, &pe);
+        return -1;
+    }
+    int ctl[2];
+    if (pipe(ctl) != 0) return -1;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close_endpoint(&pe, &ce);
+        close(ctl[0]);
+        pin_thread_to_cpu(child_cpu);
+        _exit(child_loop(mech, &ce, ctl[1], rbuf) == 0 ? 0 : 1);
+    }
+    close_endpoint(&ce, &pe);
+    close(ctl[1]);
+    if (pid < 0) {
+        close_endpoint(&pe, NULL);
+        close(ctl[0]);
+        return -1;
+    }
+    parent_loop(mech, &pe, ctl[0], sbuf, rbuf, gbps, lat_us);
+    // 出错时父进程提前返回，子进程可能还阻塞在读上：关 fd 让它退出，环上等待会自己超时
+    close_endpoint(&pe, NULL);
+    close(ctl[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (pe.tx) munmap(pe.tx < pe.rx ? pe.tx : pe.rx, 2 * sizeof(shm_ring));
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+static void format_size(char *buf, size_t len, size_t n) {
+    if (n >= (1u << 20))      snprintf(buf, len, "%zu MiB", n >> 20);
+    else if (n >= (1u << 10)) snprintf(buf, len, "%zu KiB", n >> 10);
+    else                      snprintf(buf, len, "%zu B", n);
+}
+
+int main(void) {
+    signal(SIGPIPE, SIG_IGN);
+    int ncpu = num_online_cpus();
+    int child_cpu = ncpu > 1 ? 1 : 0;
+
+    printf("[33] Inter-Process Data Transfer: pipes, UNIX sockets, vmsplice/splice, shared memory, TCP\n");
+    printf("Parent on cpu 0, child on cpu %d; %u MiB per throughput point (<= %u messages), median of %d\n",
+           child_cpu, TARGET_BYTES >> 20, MAX_MSGS, REPEAT);
+    if (pin_thread_to_cpu(0) != 0)
+        printf("NOTE: thread pinning unavailable on this platform; processes float.\n");
+    if (ncpu < 2)
+        printf("NOTE: only one CPU online; both processes share it, so every transfer includes a context switch\n"
+               "      and the spinning shared-memory ring pays for sched_yield.\n");
+#if !defined(__linux__)
+    printf("NOTE: vmsplice / splice / memfd are Linux-only; those columns are skipped\n"
+           "      (shared-memory ring uses an anonymous MAP_SHARED mapping).\n");
+#endif
+    printf("\n");
+
+    uint8_t *sbuf = aligned_alloc(4096, MAX_MSG), *rbuf = aligned_alloc(4096, MAX_MSG);
+    if (!sbuf || !rbuf) {
+        fprintf(stderr, "allocation failed\n");
+        return 1;
+    }
+    memset(sbuf, 0x5a, MAX_MSG);
+    memset(rbuf, 0, MAX_MSG);
+
+    static double gbps[NUM_MECHS][NUM_SIZES], lat[NUM_MECHS][NUM_SIZES];
+    int ok[NUM_MECHS];
+    for (int m = 0; m < NUM_MECHS; m++) {
+#if !defined(__linux__)
+        if (m == M_VMSPLICE_READ || m == M_VMSPLICE_SPLICE) { ok[m] = 0; continue; }
+#endif
+        ok[m] = run_mech(m, child_cpu, sbuf, rbuf, gbps[m], lat[m]) == 0;
+        if (!ok[m]) printf("NOTE: %s unavailable or failed; column skipped.\n", mech_names[m]);
+    }
+
+    char sz[32];
+    printf("A) Throughput (GB/s), sender streams back-to-back messages of the given size\n");
+    printf("  %8s", "Msg");
+    for (int m = 0; m < NUM_MECHS; m++) if (ok[m]) printf(" %15s", mech_names[m]);
+    printf("  %s\n", "best");
+    printf("  ------------------------------------------------------------------------------------------------------------\n");
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        format_size(sz, sizeof(sz), sizes[s]);
+        printf("  %8s", sz);
+        int best = -1;
+        for (int m = 0; m < NUM_MECHS; m++) {
+            if (!ok[m]) continue;
+            printf(" %15.3f", gbps[m][s]);
+            // vmsplice+splice 不把数据交给接收进程，不参与比较
+            if (m != M_VMSPLICE_SPLICE && (best < 0 || gbps[m][s] > gbps[best][s])) best = m;
+        }
+        printf("  %s\n", best >= 0 ? mech_names[best] : "-");
+    }
+    printf("  (vmsplice+splice discards the data into /dev/null: an upper bound for page hand-off, excluded from best)\n\n");
+
+    printf("B) One-way latency (us) = ping-pong round trip / 2\n");
+    printf("  %8s", "Msg");
+    for (int m = 0; m < NUM_MECHS; m++) if (ok[m]) printf(" %15s", mech_names[m]);
+    printf("\n");
+    printf("  ------------------------------------------------------------------------------------------------------------\n");
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        format_size(sz, sizeof(sz), sizes[s]);
+        printf("  %8s", sz);
+        for (int m = 0; m < NUM_MECHS; m++) if (ok[m]) printf(" %15.2f", lat[m][s]);
+        printf("\n");
+    }
+    printf("\n");
+
+#if defined(__linux__)
+    if (ok[M_PIPE] && ok[M_VMSPLICE_READ]) {
+        printf("C) Zero-copy payoff: vmsplice+read vs pipe throughput\n");
+        for (size_t s = 0; s < NUM_SIZES; s++) {
+            format_size(sz, sizeof(sz), sizes[s]);
+            printf("  %8s %7.2fx\n", sz, gbps[M_VMSPLICE_READ][s] / gbps[M_PIPE][s]);
+        }
+        printf("\n");
+    }
+#endif
+
+    free(sbuf);
+    free(rbuf);
+    return 0;
+}
@@ -1,11 +1,25 @@
+#define _GNU_SOURCE
 #include "harness.h"
 #include <time.h>
 #include <stdint.h>
 #include <stdlib.h>
-#include <mach/mach_time.h> 
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #if defined(__APPLE__)
   #include <mach/mach_time.h>
+  #include <sys/sysctl.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <cpuid.h>
+#endif
+
+#if defined(__linux__)
+  #include <sched.h>
+  #include <sys/syscall.h>
+  #include <linux/perf_event.h>
 #endif
 
 static int cmp_u64(const void* a, const void* b){
@@ -49,7 +63,7 @@ uint64_t timer_overhead_ns(void){
     uint64_t *samples = (uint64_t*)malloc(REPEAT * sizeof(uint64_t));
     for (size_t r=0; r<REPEAT; ++r){
         uint64_t t0 = now_ns();
-        
+        for (int k=0; k<K; ++k) (void)now_ns();
         uint64_t t1 = now_ns();
         uint64_t total = t1 - t0;
         samples[r] = total / (uint64_t)K; // 每次读表的平均 ns
@@ -61,13 +75,435 @@ uint64_t timer_overhead_ns(void){
     return ret;
 }
 
+// -------- 对数分桶直方图 --------
+// 桶号 = (shift + 1) * SUB + 次高 HIST_SUB_BITS 位；shift = 最高位 - HIST_SUB_BITS
+static int hist_bucket(uint64_t v){
+    if (v < HIST_SUB_BUCKETS) return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB_BUCKETS + (int)((v >> shift) & (HIST_SUB_BUCKETS - 1));
+}
+
+// 桶内最大值（与 HdrHistogram 的 highestEquivalentValue 一致）
+static uint64_t hist_bucket_high(int b){
+    if (b < HIST_SUB_BUCKETS) return (uint64_t)b;
+    int shift = b / HIST_SUB_BUCKETS - 1;
+    uint64_t low = (uint64_t)(HIST_SUB_BUCKETS + b % HIST_SUB_BUCKETS) << shift;
+    return low + ((1ull << shift) - 1);
+}
+
+void hist_reset(latency_hist *h){
+    for (int i = 0; i < HIST_BUCKETS; ++i) h->counts[i] = 0;
+    h->total = 0;
+    h->sum = 0;
+    h->min = UINT64_MAX;
+    h->max = 0;
+}
+
+void hist_record(latency_hist *h, uint64_t v){
+    h->counts[hist_bucket(v)]++;
+    h->total++;
+    h->sum += v;
+    if (v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+}
+
+void hist_merge(latency_hist *dst, const latency_hist *src){
+    for (int i = 0; i < HIST_BUCKETS; ++i) dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t hist_percentile(const latency_hist *h, double pct){
+    if (h->total == 0) return 0;
+    uint64_t rank = (uint64_t)(pct / 100.0 * (double)h->total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > h->total) rank = h->total;
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; ++b) {
+        seen += h->counts[b];
+        if (seen >= rank) {
+            uint64_t v = hist_bucket_high(b);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+void hist_print_header(void){
+    printf("  %-30s %9s %9s %9s %9s %9s %9s %10s\n",
+           "Operation", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+    printf("  ----------------------------------------------------------------------------------------------------\n");
+}
+
+void hist_print_row(const char *label, const latency_hist *h){
+    printf("  %-30s %9llu %9.1f %9llu %9llu %9llu %9llu %10llu\n", label,
+           (unsigned long long)h->total,
+           h->total ? (double)h->sum / (double)h->total : 0.0,
+           (unsigned long long)hist_percentile(h, 50.0),
+           (unsigned long long)hist_percentile(h, 90.0),
+           (unsigned long long)hist_percentile(h, 99.0),
+           (unsigned long long)hist_percentile(h, 99.9),
+           (unsigned long long)h->max);
+}
+
+// -------- 硬件性能计数器 --------
+// Linux 下基于 perf_event_open，只统计用户态；macOS 没有公开接口，直接返回 -1
+int hw_counter_open(int event){
+#if defined(__linux__)
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (event) {
+        case HW_CYCLES:        attr.config = PERF_COUNT_HW_CPU_CYCLES;          break;
+        case HW_INSTRUCTIONS:  attr.config = PERF_COUNT_HW_INSTRUCTIONS;        break;
+        case HW_BRANCHES:      attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS; break;
+        case HW_BRANCH_MISSES: attr.config = PERF_COUNT_HW_BRANCH_MISSES;       break;
+        default: return -1;
+    }
+    attr.disabled       = 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    // pid=0, cpu=-1：跟随当前线程
+    long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return (int)fd;
+#else
+    (void)event;
+    return -1;
+#endif
+}
+
+uint64_t hw_counter_read(int fd){
+#if defined(__linux__)
+    uint64_t v = 0;
+    if (fd < 0 || read(fd, &v, sizeof(v)) != (ssize_t)sizeof(v)) return 0;
+    return v;
+#else
+    (void)fd;
+    return 0;
+#endif
+}
+
+void hw_counter_close(int fd){
+#if defined(__linux__)
+    if (fd >= 0) close(fd);
+#else
+    (void)fd;
+#endif
+}
+
+// -------- 线程绑核与 SMT 拓扑 --------
+// 绑核 / sysfs 拓扑只在 Linux 上可用；macOS 没有硬亲和性接口，返回 -1
+int num_online_cpus(void){
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int)n : 1;
+}
+
+int pin_thread_to_cpu(int cpu){
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    // pid=0 表示调用线程本身
+    return sched_setaffinity(0, sizeof(set), &set) == 0 ? 0 : -1;
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+// 解析 sysfs 的 cpulist 格式，例如 "0,64" 或 "0-3,8-11"
+static int parse_cpu_list(const char *s, int *out, int max){
+    int n = 0;
+    while (*s && *s != '\n') {
+        char *end;
+        long lo = strtol(s, &end, 10), hi = lo;
+        if (end == s) break;
+        if (*end == '-') {
+            s = end + 1;
+            hi = strtol(s, &end, 10);
+        }
+        for (long c = lo; c <= hi && n < max; ++c) out[n++] = (int)c;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+// 读取 sysfs 中的 cpulist 文件；读不到时只返回 cpu 自身
+static int read_cpu_list_file(const char *path, int cpu, int *out, int max){
+    char line[1024];
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        if (max > 0) out[0] = cpu;
+        return max > 0 ? 1 : 0;
+    }
+    int n = 0;
+    if (fgets(line, sizeof(line), f)) n = parse_cpu_list(line, out, max);
+    fclose(f);
+    return n;
+}
+
+int cpu_smt_siblings(int cpu, int *out, int max){
+    char path[128];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    // 读不到拓扑（macOS 或容器裁剪了 sysfs）：当作没有 SMT
+    return read_cpu_list_file(path, cpu, out, max);
+}
+
+int cpu_llc_siblings(int cpu, int *out, int max){
+    char path[128];
+    // 从编号最大的 cache index 往下找，第一个存在的就是最后一级 cache
+    for (int idx = 7; idx >= 0; --idx) {
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, idx);
+        if (access(path, R_OK) == 0) return read_cpu_list_file(path, cpu, out, max);
+    }
+    if (max > 0) out[0] = cpu;
+    return max > 0 ? 1 : 0;
+}
+
+int cpu_package_id(int cpu){
+    char path[128];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int id = -1;
+    if (fscanf(f, "%d", &id) != 1) id = -1;
+    fclose(f);
+    return id;
+}
+
+// ---------------- CPU / cache 拓扑 ----------------
+
+static int read_sysfs_line(const char *path, char *buf, size_t len){
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int ok = fgets(buf, (int)len, f) != NULL;
+    fclose(f);
+    if (!ok) return -1;
+    buf[strcspn(buf, "\n")] = 0;
+    return 0;
+}
+
+static int cache_info_sysfs(cache_info *out, int max){
+    int n = 0;
+    for (int idx = 0; idx < TOPO_MAX_CACHES && n < max; ++idx) {
+        char path[128], buf[1024];
+        cache_info c;
+        memset(&c, 0, sizeof(c));
+        #define CACHE_PATH(name) \
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/" name, idx)
+        CACHE_PATH("level");
+        if (read_sysfs_line(path, buf, sizeof(buf)) != 0) break;
+        c.level = atoi(buf);
+        CACHE_PATH("type");
+        if (read_sysfs_line(path, buf, sizeof(buf)) != 0) break;
+        c.type = strcmp(buf, "Data") == 0 ? CACHE_DATA : strcmp(buf, "Instruction") == 0 ? CACHE_INST : CACHE_UNIFIED;
+        CACHE_PATH("size");
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0)
+            c.size = strtoul(buf, NULL, 10) * (strchr(buf, 'M') ? 1024u * 1024u : strchr(buf, 'K') ? 1024u : 1u);
+        CACHE_PATH("coherency_line_size");
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) c.line = strtoul(buf, NULL, 10);
+        CACHE_PATH("ways_of_associativity");
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) c.ways = atoi(buf);
+        CACHE_PATH("number_of_sets");
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) c.sets = atoi(buf);
+        CACHE_PATH("shared_cpu_list");
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) {
+            int cpus[1024];
+            c.shared_cpus = parse_cpu_list(buf, cpus, 1024);
+        }
+        #undef CACHE_PATH
+        out[n++] = c;
+    }
+    return n;
+}
+
+static int cache_info_cpuid(cache_info *out, int max){
+    int n = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned a, b, c, d;
+    if (!__get_cpuid(0, &a, &b, &c, &d)) return 0;
+    char vendor[13];
+    memcpy(vendor, &b, 4); memcpy(vendor + 4, &d, 4); memcpy(vendor + 8, &c, 4);
+    vendor[12] = 0;
+    // Intel 用 leaf 4，AMD / Hygon 用 0x8000001D，寄存器布局相同
+    int amd = strcmp(vendor, "AuthenticAMD") == 0 || strcmp(vendor, "HygonGenuine") == 0;
+    unsigned leaf = amd ? 0x8000001Du : 4u;
+    if (!amd && a < 4) return 0;
+    for (unsigned sub = 0; sub < TOPO_MAX_CACHES && n < max; ++sub) {
+        __cpuid_count(leaf, sub, a, b, c, d);
+        unsigned type = a & 0x1f;
+        if (type == 0) break;
+        cache_info ci;
+        memset(&ci, 0, sizeof(ci));
+        ci.level = (int)((a >> 5) & 7);
+        ci.type  = type == 1 ? CACHE_DATA : type == 2 ? CACHE_INST : CACHE_UNIFIED;
+        ci.line  = (b & 0xfff) + 1;
+        ci.ways  = (int)(((b >> 22) & 0x3ff) + 1);
+        ci.sets  = (int)(c + 1);
+        ci.size  = ci.line * (((b >> 12) & 0x3ff) + 1) * (size_t)ci.ways * (size_t)ci.sets;
+        ci.shared_cpus = (int)(((a >> 14) & 0xfff) + 1);
+        out[n++] = ci;
+    }
+#else
+    (void)out; (void)max;
+#endif
+    return n;
+}
+
+#if defined(__APPLE__)
+static int64_t sysctl_i64(const char *name){
+    int64_t v = 0;
+    size_t len = sizeof(v);
+    if (sysctlbyname(name, &v, &len, NULL, 0) != 0) return 0;
+    // 有的键是 32 位
+    if (len == sizeof(int32_t)) { int32_t v32; memcpy(&v32, &v, sizeof(v32)); v = v32; }
+    return v;
+}
+#endif
+
+static int cache_info_sysctl(cache_info *out, int max){
+    int n = 0;
+#if defined(__APPLE__)
+    // Apple Silicon 按性能级别分别报告，取 perflevel0（P 核）；Intel Mac 只有 hw.l*cachesize
+    int64_t line = sysctl_i64("hw.cachelinesize");
+    int64_t l1d = sysctl_i64("hw.perflevel0.l1dcachesize"), l1i = sysctl_i64("hw.perflevel0.l1icachesize");
+    int64_t l2 = sysctl_i64("hw.perflevel0.l2cachesize"), l3 = sysctl_i64("hw.perflevel0.l3cachesize");
+    int64_t per_l2 = sysctl_i64("hw.perflevel0.cpusperl2"), per_l3 = sysctl_i64("hw.perflevel0.cpusperl3");
+    if (!l1d) { l1d = sysctl_i64("hw.l1dcachesize"); l1i = sysctl_i64("hw.l1icachesize"); }
+    if (!l2)  l2 = sysctl_i64("hw.l2cachesize");
+    if (!l3)  l3 = sysctl_i64("hw.l3cachesize");
+    const struct { int level, type; int64_t size, shared; } lv[] = {
+        { 1, CACHE_DATA, l1d, 1 }, { 1, CACHE_INST, l1i, 1 },
+        { 2, CACHE_UNIFIED, l2, per_l2 }, { 3, CACHE_UNIFIED, l3, per_l3 },
+    };
+    for (size_t k = 0; k < sizeof(lv) / sizeof(lv[0]) && n < max; ++k) {
+        if (lv[k].size <= 0) continue;
+        cache_info ci;
+        memset(&ci, 0, sizeof(ci));
+        ci.level = lv[k].level;
+        ci.type = lv[k].type;
+        ci.size = (size_t)lv[k].size;
+        ci.line = (size_t)line;
+        ci.shared_cpus = (int)lv[k].shared;
+        out[n++] = ci;
+    }
+#else
+    (void)out; (void)max;
+#endif
+    return n;
+}
+
+int cache_info_read(int source, cache_info *out, int max){
+    switch (source) {
+    case CACHE_SRC_SYSFS:  return cache_info_sysfs(out, max);
+    case CACHE_SRC_CPUID:  return cache_info_cpuid(out, max);
+    case CACHE_SRC_SYSCTL: return cache_info_sysctl(out, max);
+    default:               return 0;
+    }
+}
+
+void topology_detect(cpu_topology *t){
+    static const char *names[] = { "sysfs", "cpuid", "sysctl" };
+    memset(t, 0, sizeof(*t));
+    t->ncpus = num_online_cpus();
+    t->source = "default";
+    for (int src = CACHE_SRC_SYSFS; src <= CACHE_SRC_SYSCTL; ++src) {
+        t->ncaches = cache_info_read(src, t->caches, TOPO_MAX_CACHES);
+        if (t->ncaches > 0) { t->source = names[src]; break; }
+    }
+    if (t->ncaches == 0) {
+        // 与早期 07 / 08 写死的规格一致
+        static const cache_info defaults[] = {
+            { 1, CACHE_DATA, 32u << 10, 64, 0, 0, 1 }, { 1, CACHE_INST, 32u << 10, 64, 0, 0, 1 },
+            { 2, CACHE_UNIFIED, 256u << 10, 64, 0, 0, 1 }, { 3, CACHE_UNIFIED, 4u << 20, 64, 0, 0, 0 },
+        };
+        t->ncaches = (int)(sizeof(defaults) / sizeof(defaults[0]));
+        memcpy(t->caches, defaults, sizeof(defaults));
+    }
+    // 插入排序：level 升序，同级 data / unified 在 instruction 前
+    for (int i = 1; i < t->ncaches; ++i) {
+        cache_info key = t->caches[i];
+        int j = i;
+        while (j > 0 && (t->caches[j - 1].level > key.level ||
+                         (t->caches[j - 1].level == key.level && t->caches[j - 1].type == CACHE_INST &&
+                          key.type != CACHE_INST))) {
+            t->caches[j] = t->caches[j - 1];
+            --j;
+        }
+        t->caches[j] = key;
+    }
+
+    // 核 / socket：按 (package, core_id) 去重
+#if defined(__linux__)
+    int pkgs[1024], cores[1024][2], npkg = 0, ncore = 0;
+    for (int cpu = 0; cpu < t->ncpus && cpu < 1024; ++cpu) {
+        char path[128], buf[64];
+        int pkg = cpu_package_id(cpu), core = cpu;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        if (read_sysfs_line(path, buf, sizeof(buf)) == 0) core = atoi(buf);
+        int seen = 0;
+        for (int k = 0; k < npkg; ++k) seen |= pkgs[k] == pkg;
+        if (!seen) pkgs[npkg++] = pkg;
+        seen = 0;
+        for (int k = 0; k < ncore; ++k) seen |= cores[k][0] == pkg && cores[k][1] == core;
+        if (!seen) { cores[ncore][0] = pkg; cores[ncore][1] = core; ncore++; }
+    }
+    t->ncores = ncore;
+    t->nsockets = npkg;
+#elif defined(__APPLE__)
+    t->ncores = (int)sysctl_i64("hw.physicalcpu");
+    t->nsockets = (int)sysctl_i64("hw.packages");
+#endif
+    if (t->ncores <= 0) t->ncores = t->ncpus;
+    if (t->nsockets <= 0) t->nsockets = 1;
+    t->smt = t->ncpus / t->ncores > 0 ? t->ncpus / t->ncores : 1;
+    for (int i = 0; i < t->ncaches; ++i)
+        if (t->caches[i].shared_cpus <= 0 || t->caches[i].shared_cpus > t->ncpus)
+            t->caches[i].shared_cpus = t->ncpus;
+}
+
+const cache_info *topology_cache(const cpu_topology *t, int level, int type){
+    for (int i = 0; i < t->ncaches; ++i) {
+        const cache_info *c = &t->caches[i];
+        if (c->level != level) continue;
+        if (c->type == type || (type == CACHE_DATA && c->type == CACHE_UNIFIED)) return c;
+    }
+    return NULL;
+}
+
+size_t topology_per_core(const cpu_topology *t, const cache_info *c){
+    int cores = c->shared_cpus / (t->smt > 0 ? t->smt : 1);
+    return c->size / (size_t)(cores > 0 ? cores : 1);
+}
+
+void topology_print(const cpu_topology *t){
+    static const char *types[] = { "Data", "Instruction", "Unified" };
+    printf("Topology (%s): %d CPUs, %d cores, %d socket(s), %d thread(s)/core\n",
+           t->source, t->ncpus, t->ncores, t->nsockets, t->smt);
+    for (int i = 0; i < t->ncaches; ++i) {
+        const cache_info *c = &t->caches[i];
+        printf("  L%d %-11s %8zu KiB, %3zu B line, %2d-way, shared by %3d CPU(s), %8zu KiB per core\n",
+               c->level, types[c->type], c->size >> 10, c->line, c->ways, c->shared_cpus,
+               topology_per_core(t, c) >> 10);
+    }
+}
+
 // 可单独运行测试
 #ifdef HARNESS_STANDALONE
-#include <stdio.h>
 int main(void){
     warmup_busy_loop(1000000);
     uint64_t oh = timer_overhead_ns();
     printf("harness ok. timer_overhead_ns ~ %llu ns\n",(unsigned long long)oh);
+    cpu_topology t;
+    topology_detect(&t);
+    topology_print(&t);
     return 0;
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,7 @@
+// callee.c
+// 014_call_overhead 使用的共享库：主程序调用这里的函数需要经过 PLT（macOS 上为 stub）
+#include <stdint.h>
+
+uint64_t dso_inc(uint64_t x) {
+    return x + 1;
+}